@@ -1,9 +1,14 @@
 # avesortbench.awk - script to compute averages of sort benchmarks
 # generated by sortbench.cpp.
 # Input lines look like:
-# name of sort        ,nrecs, seed,nanosecs ,recs/ns       ,whether sort successful
-# ShellSortCiura225Odd,1000000,310,840001057,1190474.692462,true
-# ShellSortCiura225Odd,1000001,301,842342466,1187166.788288,true
+# name of sort        ,nrecs, seed,nanosecs ,recs/ns       ,whether sort successful,distribution,threads
+# ShellSortCiura225Odd,1000000,310,840001057,1190474.692462,true,uniform,1
+# ShellSortCiura225Odd,1000001,301,842342466,1187166.788288,true,uniform,1
+#
+# Runs on a distribution other than uniform are averaged separately,
+# under the sort name followed by / and the distribution name.
+# Likewise, runs with more than one thread are averaged under the name
+# followed by / and the thread count with a t, e.g. ParMergeSort/8t.
 #
 # Output records look like:
 # name of sort        ,nrecs  ,ave recs/ns,nRuns,ave deviation,ratio ave dev
@@ -46,6 +51,8 @@ function procRecs() {
 
 {
     name = $1
+    if($7 != "" && $7 != "uniform") name = name "/" $7
+    if($8 != "" && $8 != 1) name = name "/" $8 "t"
     nRecs = $2
     # Collapse all records with similar nrecs to the same number.
     # The benchmark program can use similar but slightly different record
@@ -0,0 +1,96 @@
+//
+//  affinity.cpp
+//  sortbench
+//
+
+#include "affinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <set>
+#include <utility>
+
+std::vector<int> affinityAllowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(0 == pthread_getaffinity_np(pthread_self(), sizeof(set), &set)) {
+        for(int cpu=0; cpu<CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Read one integer from a sysfs topology file of a CPU.  Returns -1 on error.
+static int readCpuTopology(int cpu, const char *item)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, item);
+    FILE *file = fopen(path, "r");
+    if(NULL == file) return -1;
+    int value = -1;
+    if(1 != fscanf(file, "%d", &value)) value = -1;
+    fclose(file);
+    return value;
+}
+
+std::vector<int> affinityPhysicalCores()
+{
+    std::vector<int> cpus = affinityAllowedCpus();
+    std::vector<int> cores;
+    std::set<std::pair<int, int>> seen;
+    for(int cpu : cpus) {
+        int package = readCpuTopology(cpu, "physical_package_id");
+        int core = readCpuTopology(cpu, "core_id");
+        if(package < 0 || core < 0) return cpus;
+        if(seen.insert(std::make_pair(package, core)).second) {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+
+void affinitySetCurrentThread(const std::vector<int> &cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+bool affinityPinCurrentThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+#else
+
+std::vector<int> affinityAllowedCpus()
+{
+    return std::vector<int>();
+}
+
+std::vector<int> affinityPhysicalCores()
+{
+    return std::vector<int>();
+}
+
+void affinitySetCurrentThread(const std::vector<int> &cpus)
+{
+}
+
+bool affinityPinCurrentThread(int cpu)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,25 @@
+//
+//  affinity.h
+//  sortbench
+//
+//  Pinning threads to CPUs, so that helper threads can be kept off the
+//  core a timed sort runs on.  Only Linux lets a program choose; on other
+//  systems the CPU list is empty and pinning does nothing.
+//
+
+#ifndef affinity_h
+#define affinity_h
+
+#include <vector>
+
+// The CPUs the calling thread may run on, in increasing order.
+std::vector<int> affinityAllowedCpus();
+// One allowed CPU for each physical core: the first of its hyperthreads.
+// Falls back to all allowed CPUs if the topology can't be read.
+std::vector<int> affinityPhysicalCores();
+// Restrict the calling thread to one CPU.  Returns false if not possible.
+bool affinityPinCurrentThread(int cpu);
+// Let the calling thread run on any of cpus again.
+void affinitySetCurrentThread(const std::vector<int> &cpus);
+
+#endif /* affinity_h */
@@ -0,0 +1,89 @@
+//
+//  arena.cpp
+//  sortbench
+//
+
+#include "arena.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Size of the pages MAP_HUGETLB and THP use on x86-64 and arm64 Linux.
+static const size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+const char *nameOfHugePages(TypHugePages hugePages)
+{
+    switch(hugePages) {
+        case HUGEPAGES_NONE:    return "none";
+        case HUGEPAGES_THP:     return "thp";
+        case HUGEPAGES_HUGETLB: return "hugetlb";
+    }
+    return "unknown";
+}
+
+static size_t roundUp(size_t bytes, size_t unit)
+{
+    return (bytes + unit - 1) / unit * unit;
+}
+
+static char *mapAnonymous(size_t bytes, int extraFlags)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | extraFlags, -1, 0);
+    return MAP_FAILED == p ? NULL : (char *) p;
+}
+
+bool arenaInit(Arena *arena, size_t capacity, TypHugePages hugePages, bool bPrefault)
+{
+    arena->base = NULL;
+    arena->used = 0;
+    arena->capacity = roundUp(capacity > 0 ? capacity : 1, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+    if(HUGEPAGES_HUGETLB == hugePages) {
+        arena->base = mapAnonymous(arena->capacity, MAP_HUGETLB);
+        arena->pages = HUGEPAGES_HUGETLB;
+    }
+#endif
+    if(NULL == arena->base) {
+        arena->base = mapAnonymous(arena->capacity, 0);
+        if(NULL == arena->base) {
+            arena->capacity = 0;
+            return false;
+        }
+        arena->pages = HUGEPAGES_NONE;
+#ifdef MADV_HUGEPAGE
+        // Ask for transparent huge pages.  The kernel may still use small
+        // pages, for instance if THP is disabled or memory is fragmented.
+        if(HUGEPAGES_NONE != hugePages && 0 == madvise(arena->base, arena->capacity, MADV_HUGEPAGE)) {
+            arena->pages = HUGEPAGES_THP;
+        }
+#endif
+    }
+    if(bPrefault) {
+        size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        for(size_t offset=0; offset<arena->capacity; offset+=pageSize) {
+            arena->base[offset] = 0;
+        }
+    }
+    return true;
+}
+
+void *arenaAlloc(Arena *arena, size_t bytes)
+{
+    size_t start = roundUp(arena->used, ARENA_ALIGN);
+    if(start + bytes > arena->capacity) return NULL;
+    arena->used = start + bytes;
+    return arena->base + start;
+}
+
+void arenaReset(Arena *arena)
+{
+    arena->used = 0;
+}
+
+void arenaFree(Arena *arena)
+{
+    if(NULL != arena->base) {
+        munmap(arena->base, arena->capacity);
+    }
+    arena->base = NULL;
+    arena->capacity = arena->used = 0;
+}
@@ -0,0 +1,49 @@
+//
+//  arena.h
+//  sortbench
+//
+//  A bump allocator for the benchmark arrays.  The memory is mapped once,
+//  optionally backed by huge pages and pre-faulted, and reused by resetting
+//  the arena, so page faults and zeroing don't happen inside timed loops.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum TypHugePages {HUGEPAGES_NONE, HUGEPAGES_THP, HUGEPAGES_HUGETLB};
+
+// Allocations are aligned to a cache line.
+const size_t ARENA_ALIGN = 64;
+
+struct Arena {
+    char    *base = NULL;
+    size_t  capacity = 0;
+    size_t  used = 0;
+    TypHugePages pages = HUGEPAGES_NONE;   // What the memory actually got.
+};
+
+const char *nameOfHugePages(TypHugePages hugePages);
+
+// Map capacity bytes.  If huge pages of the requested kind are not
+// available, falls back to THP and then to normal pages; arena->pages
+// tells what was used.  If bPrefault, every page is touched now.
+// Returns false if the memory could not be mapped at all.
+bool arenaInit(Arena *arena, size_t capacity, TypHugePages hugePages, bool bPrefault);
+// Returns NULL if the arena doesn't have room.
+void *arenaAlloc(Arena *arena, size_t bytes);
+// Make all of the arena's memory available again.
+void arenaReset(Arena *arena);
+void arenaFree(Arena *arena);
+
+// Allocate n objects of type T.  The memory is not initialized, so T
+// should be trivially constructible.
+template<typename T>
+T *arenaAllocArray(Arena *arena, int64_t n)
+{
+    return (T *) arenaAlloc(arena, n*sizeof(T));
+}
+
+#endif /* arena_h */
@@ -0,0 +1,83 @@
+//
+//  datasetcache.cpp
+//  sortbench
+//
+
+#include "datasetcache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+
+std::string datasetFileName(const char *cacheDir, uint64_t seed, int64_t nRecords)
+{
+    char name[80];
+    snprintf(name, sizeof(name), "/sortbench-s%llu-n%lld.dat", (unsigned long long) seed, (long long) nRecords);
+    return std::string(cacheDir) + name;
+}
+
+static void fillHeader(TypDatasetHeader &header, const char *generator, uint64_t seed,
+                       int64_t nRecords, size_t recordSize)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.recordSize = (uint32_t) recordSize;
+    header.headerSize = sizeof(header);
+    header.nRecords = nRecords;
+    header.seed = seed;
+    strncpy(header.generator, generator, sizeof(header.generator)-1);
+}
+
+bool datasetLoad(const char *cacheDir, const char *generator, uint64_t seed,
+                 int64_t nRecords, size_t recordSize, void *records)
+{
+    std::string fileName = datasetFileName(cacheDir, seed, nRecords);
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    bool bOK = false;
+    struct stat st;
+    size_t fileSize = sizeof(TypDatasetHeader) + nRecords*recordSize;
+    if(0 == fstat(fd, &st) && (size_t) st.st_size == fileSize) {
+        void *map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED != map) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, fileSize, MADV_SEQUENTIAL);
+#endif
+            TypDatasetHeader expected;
+            fillHeader(expected, generator, seed, nRecords, recordSize);
+            if(0 == memcmp(map, &expected, sizeof(expected))) {
+                memcpy(records, (const char *) map + sizeof(TypDatasetHeader), nRecords*recordSize);
+                bOK = true;
+            }
+            munmap(map, fileSize);
+        }
+    }
+    close(fd);
+    return bOK;
+}
+
+bool datasetSave(const char *cacheDir, const char *generator, uint64_t seed,
+                 int64_t nRecords, size_t recordSize, const void *records)
+{
+    std::string fileName = datasetFileName(cacheDir, seed, nRecords);
+    // Unique to this save, since -jobs workers may save the same dataset at once.
+    static std::atomic<int> nSaves(0);
+    std::string tempName = fileName + ".tmp" + std::to_string(getpid()) + "." + std::to_string(nSaves++);
+    FILE *file = fopen(tempName.c_str(), "wb");
+    if(NULL == file) return false;
+    TypDatasetHeader header;
+    fillHeader(header, generator, seed, nRecords, recordSize);
+    bool bOK = 1 == fwrite(&header, sizeof(header), 1, file) &&
+        (size_t) nRecords == fwrite(records, recordSize, nRecords, file);
+    bOK = (0 == fclose(file)) && bOK;
+    if(bOK) {
+        bOK = 0 == rename(tempName.c_str(), fileName.c_str());
+    }
+    if(!bOK) {
+        unlink(tempName.c_str());
+    }
+    return bOK;
+}
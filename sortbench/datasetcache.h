@@ -0,0 +1,44 @@
+//
+//  datasetcache.h
+//  sortbench
+//
+//  On-disk cache of generated datasets, keyed by seed and record count.
+//  A dataset file is a TypDatasetHeader followed by the records.  Files
+//  are memory-mapped read-only and copied into the caller's arrays, so
+//  sorts always work on private memory that is already faulted in.
+//
+
+#ifndef datasetcache_h
+#define datasetcache_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+const char DATASET_MAGIC[8] = {'S','B','D','A','T','A','S','1'};
+
+struct TypDatasetHeader {
+    char        magic[8];
+    uint32_t    recordSize;
+    uint32_t    headerSize;
+    int64_t     nRecords;
+    uint64_t    seed;
+    // Identifies how the records were generated, so that files made by a
+    // different generator are not used.
+    char        generator[32];
+};
+
+// Returns the file name for a dataset in cacheDir.
+std::string datasetFileName(const char *cacheDir, uint64_t seed, int64_t nRecords);
+
+// Copy a cached dataset into records, which must have room for nRecords.
+// Returns false if there is no matching dataset in the cache.
+bool datasetLoad(const char *cacheDir, const char *generator, uint64_t seed,
+                 int64_t nRecords, size_t recordSize, void *records);
+
+// Write a dataset to the cache.  The file is written under a temporary
+// name and renamed, so concurrent runs never see a partial file.
+bool datasetSave(const char *cacheDir, const char *generator, uint64_t seed,
+                 int64_t nRecords, size_t recordSize, const void *records);
+
+#endif /* datasetcache_h */
@@ -0,0 +1,161 @@
+//
+//  externalsort.cpp
+//  sortbench
+//
+
+#include "externalsort.h"
+#include <errno.h>
+#include <string.h>
+
+//=====  Asynchronous I/O helpers  ====================================
+
+// Fill in a control block for a transfer of bytes at offset.
+static void prepareIO(struct aiocb *pcb, int fd, off_t offset, char *buf, size_t bytes)
+{
+    memset(pcb, 0, sizeof(*pcb));
+    pcb->aio_fildes = fd;
+    pcb->aio_offset = offset;
+    pcb->aio_buf = buf;
+    pcb->aio_nbytes = bytes;
+}
+
+// Wait for an operation to finish.  Returns false unless it transferred
+// all its bytes.
+static bool waitIO(struct aiocb *pcb)
+{
+    const struct aiocb *list[1] = {pcb};
+    int err;
+    while(EINPROGRESS == (err = aio_error(pcb))) {
+        aio_suspend(list, 1, NULL);
+    }
+    ssize_t bytes = aio_return(pcb);
+    return 0 == err && bytes == (ssize_t) pcb->aio_nbytes;
+}
+
+//=====  RunReader  ===================================================
+
+// Request the next block of the run into the buffer not being consumed.
+static void readerRequest(RunReader *pReader)
+{
+    pReader->bPending = false;
+    if(pReader->nUnrequested <= 0) return;
+    int64_t nRecs = pReader->nUnrequested < pReader->bufRecords ? pReader->nUnrequested : pReader->bufRecords;
+    size_t bytes = nRecs * pReader->recordSize;
+    prepareIO(&pReader->cb, pReader->fd, pReader->nextOffset, pReader->buf[pReader->cur ^ 1], bytes);
+    if(0 != aio_read(&pReader->cb)) {
+        pReader->bError = true;
+        return;
+    }
+    pReader->nextOffset += bytes;
+    pReader->nUnrequested -= nRecs;
+    pReader->pendingRecords = nRecs;
+    pReader->bPending = true;
+}
+
+bool runReaderOpen(RunReader *pReader, int fd, off_t start, int64_t nRecords,
+                   size_t recordSize, int64_t bufRecords)
+{
+    pReader->fd = fd;
+    pReader->recordSize = recordSize;
+    pReader->bufRecords = bufRecords;
+    pReader->nextOffset = start;
+    pReader->nUnrequested = nRecords;
+    pReader->buf[0] = new char[bufRecords*recordSize];
+    pReader->buf[1] = new char[bufRecords*recordSize];
+    pReader->cur = 1;
+    pReader->curRecords = pReader->curPos = 0;
+    pReader->bPending = false;
+    pReader->bError = false;
+    // Get the first block into buffer 0; runReaderNext will switch to it
+    // and start reading the second.
+    readerRequest(pReader);
+    return !pReader->bError;
+}
+
+const char *runReaderNext(RunReader *pReader)
+{
+    if(pReader->curPos >= pReader->curRecords) {
+        if(!pReader->bPending) return NULL;
+        pReader->bPending = false;
+        if(!waitIO(&pReader->cb)) {
+            pReader->bError = true;
+            return NULL;
+        }
+        pReader->cur ^= 1;
+        pReader->curRecords = pReader->pendingRecords;
+        pReader->curPos = 0;
+        readerRequest(pReader);
+    }
+    return pReader->buf[pReader->cur] + (pReader->curPos++)*pReader->recordSize;
+}
+
+bool runReaderClose(RunReader *pReader)
+{
+    if(pReader->bPending) {
+        waitIO(&pReader->cb);
+        pReader->bPending = false;
+    }
+    delete [](pReader->buf[0]);
+    delete [](pReader->buf[1]);
+    pReader->buf[0] = pReader->buf[1] = NULL;
+    return !pReader->bError;
+}
+
+//=====  RunWriter  ===================================================
+
+// Start writing the current buffer and switch to the other one.
+static void writerFlush(RunWriter *pWriter)
+{
+    if(pWriter->bPending) {
+        if(!waitIO(&pWriter->cb)) pWriter->bError = true;
+        pWriter->bPending = false;
+    }
+    if(0 == pWriter->curRecords) return;
+    size_t bytes = pWriter->curRecords * pWriter->recordSize;
+    prepareIO(&pWriter->cb, pWriter->fd, pWriter->offset, pWriter->buf[pWriter->cur], bytes);
+    if(0 != aio_write(&pWriter->cb)) {
+        pWriter->bError = true;
+    } else {
+        pWriter->bPending = true;
+    }
+    pWriter->offset += bytes;
+    pWriter->cur ^= 1;
+    pWriter->curRecords = 0;
+}
+
+bool runWriterOpen(RunWriter *pWriter, int fd, off_t start, size_t recordSize, int64_t bufRecords)
+{
+    pWriter->fd = fd;
+    pWriter->recordSize = recordSize;
+    pWriter->bufRecords = bufRecords;
+    pWriter->offset = start;
+    pWriter->buf[0] = new char[bufRecords*recordSize];
+    pWriter->buf[1] = new char[bufRecords*recordSize];
+    pWriter->cur = 0;
+    pWriter->curRecords = 0;
+    pWriter->bPending = false;
+    pWriter->bError = false;
+    return true;
+}
+
+void runWriterPut(RunWriter *pWriter, const char *record)
+{
+    memcpy(pWriter->buf[pWriter->cur] + pWriter->curRecords*pWriter->recordSize, record, pWriter->recordSize);
+    if(++pWriter->curRecords == pWriter->bufRecords) {
+        writerFlush(pWriter);
+    }
+}
+
+bool runWriterClose(RunWriter *pWriter)
+{
+    writerFlush(pWriter);
+    // writerFlush waits only for the previous write; wait for the last one.
+    if(pWriter->bPending) {
+        if(!waitIO(&pWriter->cb)) pWriter->bError = true;
+        pWriter->bPending = false;
+    }
+    delete [](pWriter->buf[0]);
+    delete [](pWriter->buf[1]);
+    pWriter->buf[0] = pWriter->buf[1] = NULL;
+    return !pWriter->bError;
+}
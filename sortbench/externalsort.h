@@ -0,0 +1,143 @@
+//
+//  externalsort.h
+//  sortbench
+//
+//  Building blocks for an external-memory sort of fixed-size records:
+//  buffered run readers and writers that overlap disk I/O with the caller's
+//  work using POSIX asynchronous I/O, and a loser tree for the k-way merge.
+//
+
+#ifndef externalsort_h
+#define externalsort_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <aio.h>
+#include <vector>
+
+//=====  Asynchronous run I/O  ========================================
+// Each reader and writer has two buffers.  While the caller consumes or
+// fills one, the other is being read or written in the background.
+
+// Reads nRecords records starting at a file offset.
+struct RunReader {
+    int     fd;
+    size_t  recordSize;
+    int64_t bufRecords;
+    off_t   nextOffset;         // Offset of the next block to request.
+    int64_t nUnrequested;       // Records not yet requested.
+    char    *buf[2] = {NULL, NULL};
+    int     cur;                // The buffer being consumed.
+    int64_t curRecords;
+    int64_t curPos;
+    struct aiocb cb;
+    bool    bPending;
+    int64_t pendingRecords;
+    bool    bError;
+};
+
+bool runReaderOpen(RunReader *pReader, int fd, off_t start, int64_t nRecords,
+                   size_t recordSize, int64_t bufRecords);
+// Returns the next record, or NULL at the end of the run or on error.
+// The record stays valid until the following call.
+const char *runReaderNext(RunReader *pReader);
+// Returns false if there was a read error.
+bool runReaderClose(RunReader *pReader);
+
+// Writes records sequentially from a file offset.
+struct RunWriter {
+    int     fd;
+    size_t  recordSize;
+    int64_t bufRecords;
+    off_t   offset;             // Offset at which the next block goes.
+    char    *buf[2] = {NULL, NULL};
+    int     cur;                // The buffer being filled.
+    int64_t curRecords;
+    struct aiocb cb;
+    bool    bPending;
+    bool    bError;
+};
+
+bool runWriterOpen(RunWriter *pWriter, int fd, off_t start, size_t recordSize, int64_t bufRecords);
+void runWriterPut(RunWriter *pWriter, const char *record);
+// Write any buffered records and wait for all writes.
+// Returns false if there was a write error.
+bool runWriterClose(RunWriter *pWriter);
+
+//=====  Loser tree  ==================================================
+// A tournament tree for merging k sorted sources.  Leaf i (node k+i) is
+// source i; each internal node 1..k-1 holds the loser of the match played
+// there, and node 0 holds the overall winner.  Replacing the winner's
+// record replays only the matches on its path to the root: log2(k)
+// comparisons per record.  An exhausted source has a NULL record and loses
+// every match.  Ties go to the lower source index, so the merge is stable.
+
+template<typename Greater>
+struct LoserTree {
+    int     k;
+    std::vector<int> node;
+    std::vector<const char *> current;
+    Greater gt;
+
+    // True if source a wins against (comes before) source b.
+    bool beats(int a, int b) const
+    {
+        if(NULL == current[a]) return false;
+        if(NULL == current[b]) return true;
+        if(gt(current[a], current[b])) return false;
+        if(gt(current[b], current[a])) return true;
+        return a < b;
+    }
+};
+
+// Build the tree from each source's first record.
+template<typename Greater>
+void loserTreeInit(LoserTree<Greater> &lt, const std::vector<const char *> &first, Greater gt)
+{
+    lt.k = (int) first.size();
+    lt.current = first;
+    lt.gt = gt;
+    lt.node.assign(lt.k > 1 ? lt.k : 1, 0);
+    std::vector<int> winner(2*lt.k);
+    for(int i=0; i<lt.k; i++) {
+        winner[lt.k+i] = i;
+    }
+    for(int inode=lt.k-1; inode>=1; inode--) {
+        int left = winner[2*inode], right = winner[2*inode+1];
+        if(lt.beats(left, right)) {
+            winner[inode] = left;
+            lt.node[inode] = right;
+        } else {
+            winner[inode] = right;
+            lt.node[inode] = left;
+        }
+    }
+    lt.node[0] = lt.k > 1 ? winner[1] : 0;
+}
+
+// Returns the source whose record comes next, or -1 if all are exhausted.
+template<typename Greater>
+int loserTreeWinner(const LoserTree<Greater> &lt)
+{
+    int w = lt.node[0];
+    return (lt.k > 0 && NULL != lt.current[w]) ? w : -1;
+}
+
+// Give the winning source its next record (NULL if exhausted).
+template<typename Greater>
+void loserTreeReplaceWinner(LoserTree<Greater> &lt, const char *record)
+{
+    int w = lt.node[0];
+    lt.current[w] = record;
+    for(int inode=(lt.k+w)/2; inode>=1; inode/=2) {
+        if(lt.beats(lt.node[inode], w)) {
+            int swap = lt.node[inode];
+            lt.node[inode] = w;
+            w = swap;
+        }
+    }
+    lt.node[0] = w;
+}
+
+#endif /* externalsort_h */
@@ -0,0 +1,105 @@
+//
+//  infile.cpp
+//  sortbench
+//
+
+#include "infile.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+bool inputFileOpen(InputFile *pIn, const char *fileName, TypInFormat format, size_t recordSize)
+{
+    pIn->format = format;
+    pIn->recordSize = recordSize;
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(0 != fstat(fd, &st)) {
+        close(fd);
+        return false;
+    }
+    pIn->size = (size_t) st.st_size;
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    pIn->mapSize = (pIn->size + pageSize - 1) / pageSize * pageSize + pageSize;
+    // Reserve zeroed memory for the whole range, then map the file over
+    // the start of it.
+    void *region = mmap(NULL, pIn->mapSize, PROT_READ, MAP_PRIVATE | MAP_ANON, -1, 0);
+    bool bOK = MAP_FAILED != region;
+    if(bOK && pIn->size > 0) {
+        int flags = MAP_PRIVATE | MAP_FIXED;
+#ifdef MAP_POPULATE
+        // Fault the file in now, rather than during the first timed sort.
+        flags |= MAP_POPULATE;
+#endif
+        bOK = MAP_FAILED != mmap(region, pIn->size, PROT_READ, flags, fd, 0);
+        if(!bOK) munmap(region, pIn->mapSize);
+    }
+    close(fd);
+    pIn->base = bOK ? (char *) region : NULL;
+    return bOK;
+}
+
+void inputFileClose(InputFile *pIn)
+{
+    if(NULL != pIn->base) {
+        munmap(pIn->base, pIn->mapSize);
+    }
+    pIn->base = NULL;
+    pIn->size = pIn->mapSize = 0;
+}
+
+size_t inputFileRecords(const InputFile *pIn, std::vector<const char *> &starts)
+{
+    starts.clear();
+    if(INFORMAT_RECORDS == pIn->format) {
+        size_t nRecords = pIn->size / pIn->recordSize;
+        starts.reserve(nRecords);
+        for(size_t j=0; j<nRecords; j++) {
+            starts.push_back(pIn->base + j*pIn->recordSize);
+        }
+        return pIn->size - nRecords*pIn->recordSize;
+    }
+    const char *p = pIn->base, *end = pIn->base + pIn->size;
+    while(p < end) {
+        starts.push_back(p);
+        const char *newline = (const char *) memchr(p, '\n', end - p);
+        p = NULL == newline ? end : newline + 1;
+    }
+    return 0;
+}
+
+size_t inputFileRecordLength(const InputFile *pIn, const char *pRecord)
+{
+    if(INFORMAT_RECORDS == pIn->format) return pIn->recordSize;
+    const char *end = pIn->base + pIn->size;
+    const char *newline = (const char *) memchr(pRecord, '\n', end - pRecord);
+    return (NULL == newline ? end : newline + 1) - pRecord;
+}
+
+bool writeAllIovecs(int fd, struct iovec iov[], int64_t nIov)
+{
+    while(nIov > 0) {
+        int count = nIov < IOV_MAX ? (int) nIov : IOV_MAX;
+        ssize_t written = writev(fd, iov, count);
+        if(written < 0) return false;
+        // Skip the iovecs that were written completely, and trim a partial one.
+        while(nIov > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            nIov--;
+        }
+        if(written > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
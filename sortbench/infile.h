@@ -0,0 +1,76 @@
+//
+//  infile.h
+//  sortbench
+//
+//  Input files of real records, memory-mapped so that the records can be
+//  sorted in place by pointer, without copying.  A file is either
+//  fixed-width records or newline-delimited lines.
+//
+
+#ifndef infile_h
+#define infile_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <vector>
+
+enum TypInFormat {INFORMAT_RECORDS, INFORMAT_LINES};
+
+struct InputFile {
+    char        *base = NULL;
+    size_t      size = 0;       // Bytes of file data.
+    size_t      mapSize = 0;    // Bytes mapped, including the zero page after the data.
+    TypInFormat format = INFORMAT_RECORDS;
+    size_t      recordSize = 0;
+};
+
+// Map a file read-only.  The mapping is followed by at least one page of
+// zeros, so a comparison that runs off the end of a short last record
+// sees a NUL instead of faulting.
+bool inputFileOpen(InputFile *pIn, const char *fileName, TypInFormat format, size_t recordSize);
+void inputFileClose(InputFile *pIn);
+
+// Set starts to the address of each record, in file order.  For records,
+// a partial record at the end of the file is ignored; returns the number
+// of bytes ignored.
+size_t inputFileRecords(const InputFile *pIn, std::vector<const char *> &starts);
+
+// Returns the length in bytes of the record at pRecord, including the
+// newline of a line.
+size_t inputFileRecordLength(const InputFile *pIn, const char *pRecord);
+
+// Write iovecs to fd with as few writev calls as IOV_MAX allows,
+// resuming after partial writes.  Returns false on error.
+bool writeAllIovecs(int fd, struct iovec iov[], int64_t nIov);
+
+// Write the records, in the order given, to a new file.  Returns false on error.
+template<typename T>
+bool inputFileWriteSorted(const InputFile *pIn, const T records[], int64_t n, int fd)
+{
+    const int64_t BATCH = 1024;
+    struct iovec iov[BATCH+1];
+    static const char newline[] = "\n";
+    int64_t nIov = 0;
+    for(int64_t j=0; j<n; j++) {
+        const char *pRecord = (const char *) records[j];
+        size_t len = inputFileRecordLength(pIn, pRecord);
+        iov[nIov].iov_base = (void *) pRecord;
+        iov[nIov].iov_len = len;
+        nIov++;
+        // A last line without a newline gets one, unless it stays last.
+        if(INFORMAT_LINES == pIn->format && pRecord + len == pIn->base + pIn->size &&
+           (0 == len || '\n' != pRecord[len-1]) && j < n-1) {
+            iov[nIov].iov_base = (void *) newline;
+            iov[nIov].iov_len = 1;
+            nIov++;
+        }
+        if(nIov >= BATCH) {
+            if(!writeAllIovecs(fd, iov, nIov)) return false;
+            nIov = 0;
+        }
+    }
+    return writeAllIovecs(fd, iov, nIov);
+}
+
+#endif /* infile_h */
@@ -0,0 +1,163 @@
+//
+//  keycompare.h
+//  sortbench
+//
+//  Comparison of sort keys: len bytes at offset off in each record,
+//  compared as unsigned bytes, as memcmp() does.  The records sortbench
+//  generates have no NULs before their last byte, so this is the same
+//  order strncmp() gives, without its NUL checks or call.
+//  How a key is compared depends on its length:
+//  - up to 8 bytes: one byte-swapped 64-bit load each, compared as integers;
+//  - 9 to 16 bytes: two such loads, the second overlapping the first;
+//  - longer: vector compares, AVX2 or SSE2, finding the first byte that
+//    differs with a movemask.  Without either, 64-bit loads are used.
+//  No load reaches outside the bytes from off to the larger of off+len
+//  and 8, so records may be as short as 8 bytes.
+//
+
+#ifndef keycompare_h
+#define keycompare_h
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// A key must end at or before this byte of a DataRecord, its NUL.
+const int KEY_END_MAX = 71;
+// The key is the first 6 bytes unless -keyoff or -keylen say otherwise.
+const int KEY_LEN_DEFAULT = 6;
+// Keys up to this long fit in one word.
+const int KEY_WORD_LEN = 8;
+
+enum TypKeyKind {KEY_WORD, KEY_TWO_WORDS, KEY_VECTOR};
+
+struct KeySpec {
+    int         off = 0;
+    int         len = KEY_LEN_DEFAULT;
+    TypKeyKind  kind = KEY_WORD;
+    // For KEY_WORD, the word loaded at wordOff is shifted left by
+    // wordShift bits and masked with wordMask to leave just the key.
+    int         wordOff = 0;
+    int         wordShift = 0;
+    uint64_t    wordMask = 0;
+};
+
+// Set up spec for the key of len bytes at off.
+// Entry:   off >= 0, len >= 1.
+inline void keySpecInit(KeySpec &spec, int off, int len)
+{
+    spec.off = off;
+    spec.len = len;
+    spec.kind = len <= KEY_WORD_LEN ? KEY_WORD : len <= 2*KEY_WORD_LEN ? KEY_TWO_WORDS : KEY_VECTOR;
+    // Load the word that ends with the key, unless that would start
+    // before the record.
+    spec.wordOff = off + len - KEY_WORD_LEN;
+    if(spec.wordOff < 0) spec.wordOff = 0;
+    spec.wordShift = 8*(off - spec.wordOff);
+    spec.wordMask = len >= KEY_WORD_LEN ? ~(uint64_t) 0 : ~(uint64_t) 0 << 8*(KEY_WORD_LEN - len);
+}
+
+// Returns 8 bytes at p as a big-endian integer, so that integer order is
+// memcmp() order.
+inline uint64_t keyLoadWord(const char *p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return __builtin_bswap64(word);
+}
+
+// Returns the first 8 bytes of a record's key, or all of it if shorter,
+// as a big-endian integer with any unused low bytes zero.
+inline uint64_t keyPrefixWord(const KeySpec &spec, const char *rec)
+{
+    if(KEY_WORD == spec.kind) {
+        return (keyLoadWord(rec + spec.wordOff) << spec.wordShift) & spec.wordMask;
+    }
+    return keyLoadWord(rec + spec.off);
+}
+
+//=====  Longer keys  =================================================
+// Each chunk compare sets ne to a mask of the bytes that differ and aGe
+// to a mask of the bytes at which first is at least second.  The lowest
+// bit of ne is the first difference, so first is greater exactly when
+// that bit is also set in aGe.
+
+#if defined(__AVX2__)
+inline void keyDiff32(const char *first, const char *second, uint32_t &ne, uint32_t &aGe)
+{
+    __m256i va = _mm256_loadu_si256((const __m256i *) first);
+    __m256i vb = _mm256_loadu_si256((const __m256i *) second);
+    ne = ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+    aGe = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(va, vb), va));
+}
+#endif
+
+#if defined(__SSE2__)
+inline void keyDiff16(const char *first, const char *second, uint32_t &ne, uint32_t &aGe)
+{
+    __m128i va = _mm_loadu_si128((const __m128i *) first);
+    __m128i vb = _mm_loadu_si128((const __m128i *) second);
+    ne = ~(uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xffff;
+    aGe = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(va, vb), va));
+}
+#endif
+
+inline void keyDiff8(const char *first, const char *second, uint32_t &ne, uint32_t &aGe)
+{
+    uint64_t wa = keyLoadWord(first), wb = keyLoadWord(second);
+    ne = wa != wb;
+    aGe = wa >= wb;
+}
+
+// Compare keys of len >= CHUNK bytes a chunk at a time.  The last chunk
+// is loaded so that it ends with the key; it may overlap the chunk before,
+// whose bytes are already known to be equal.
+template<int CHUNK, void (*DIFF)(const char *, const char *, uint32_t &, uint32_t &)>
+inline bool keyChunksGreater(const char *first, const char *second, int len)
+{
+    int pos = 0;
+    for(;;) {
+        if(pos + CHUNK > len) pos = len - CHUNK;
+        uint32_t ne, aGe;
+        DIFF(first + pos, second + pos, ne, aGe);
+        if(0 != ne) return 0 != (aGe & ne & (0 - ne));
+        pos += CHUNK;
+        if(pos >= len) return false;
+    }
+}
+
+// Compare keys longer than 2*KEY_WORD_LEN bytes.
+inline bool keyVectorGreater(const char *first, const char *second, int len)
+{
+#if defined(__AVX2__)
+    if(len >= 32) return keyChunksGreater<32, keyDiff32>(first, second, len);
+#endif
+#if defined(__SSE2__)
+    return keyChunksGreater<16, keyDiff16>(first, second, len);
+#else
+    return keyChunksGreater<8, keyDiff8>(first, second, len);
+#endif
+}
+
+//=====  Entry point  =================================================
+
+// Returns true if the key of record first is greater than that of second.
+inline bool keyGreater(const KeySpec &spec, const char *first, const char *second)
+{
+    switch(spec.kind) {
+        case KEY_WORD:
+            return keyPrefixWord(spec, first) > keyPrefixWord(spec, second);
+        case KEY_TWO_WORDS: {
+            uint64_t a1 = keyLoadWord(first + spec.off), b1 = keyLoadWord(second + spec.off);
+            int off2 = spec.off + spec.len - KEY_WORD_LEN;
+            uint64_t a2 = keyLoadWord(first + off2), b2 = keyLoadWord(second + off2);
+            return (a1 > b1) | ((a1 == b1) & (a2 > b2));
+        }
+        default:
+            return keyVectorGreater(first + spec.off, second + spec.off, spec.len);
+    }
+}
+
+#endif /* keycompare_h */
@@ -0,0 +1,89 @@
+//
+//  opcount.h
+//  sortbench
+//
+//  Operation counting for the template sorts.  Instantiating a sort with
+//  Counted<T> elements and a CountingGreater<> comparison counts every
+//  comparison and every element copy (a "move"), without changing the
+//  sort's code.  The normal timed instantiations don't use any of this.
+//
+
+#ifndef opcount_h
+#define opcount_h
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Totals for the sort in progress.  Atomic so multi-threaded sorts count
+// correctly; relaxed increments are enough since they are read afterwards.
+extern std::atomic<int64_t> opCompares;
+extern std::atomic<int64_t> opMoves;
+
+inline void opCountsReset()
+{
+    opCompares.store(0, std::memory_order_relaxed);
+    opMoves.store(0, std::memory_order_relaxed);
+}
+
+// An element wrapper that counts copies.  Converting from and to T is not
+// counted, so callers can copy arrays in and out for free.
+template<typename T>
+struct Counted {
+    T value;
+
+    Counted() = default;
+    explicit Counted(const T &val) : value(val) {}
+    Counted(const Counted &other) : value(other.value) {
+        opMoves.fetch_add(1, std::memory_order_relaxed);
+    }
+    Counted &operator=(const Counted &other) {
+        value = other.value;
+        opMoves.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+    operator const T &() const {
+        return value;
+    }
+};
+
+// Wraps a "greater than" functor on T and counts calls.
+template<typename Greater>
+struct CountingGreater {
+    template<typename T>
+    bool operator()(const Counted<T> &first, const Counted<T> &second) const {
+        opCompares.fetch_add(1, std::memory_order_relaxed);
+        return Greater()(first.value, second.value);
+    }
+};
+
+// Counts for one Shellsort pass.
+struct TypPassCounts {
+    int64_t gap;
+    int64_t compares;
+    int64_t moves;
+};
+
+// Per-pass counts of the last counted Shellsort.
+extern std::vector<TypPassCounts> opPassCounts;
+
+// Shellsort pass hook (see NoShellPassHook) that records counts per gap
+// in opPassCounts.
+struct CountingPassHook {
+    int64_t startCompares = 0;
+    int64_t startMoves = 0;
+
+    void beginPass(int64_t gap) {
+        startCompares = opCompares.load(std::memory_order_relaxed);
+        startMoves = opMoves.load(std::memory_order_relaxed);
+    }
+    void endPass(int64_t gap) {
+        TypPassCounts counts;
+        counts.gap = gap;
+        counts.compares = opCompares.load(std::memory_order_relaxed) - startCompares;
+        counts.moves = opMoves.load(std::memory_order_relaxed) - startMoves;
+        opPassCounts.push_back(counts);
+    }
+};
+
+#endif /* opcount_h */
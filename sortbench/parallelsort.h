@@ -0,0 +1,185 @@
+//
+//  parallelsort.h
+//  sortbench
+//
+//  Multi-threaded sorts.  Like sortengines.h, these are templates on
+//  the element type and a "greater than" functor.
+//
+
+#ifndef parallelsort_h
+#define parallelsort_h
+
+#include <stdint.h>
+#include <thread>
+#include <barrier>
+#include <vector>
+#include <algorithm>
+#include "sortengines.h"
+#include "taskpool.h"
+
+//=====  Parallel Shellsort  ==========================================
+// Each pass of Shellsort with gap g consists of g independent chains:
+// elements c, c+g, c+2g, ... for c = 0..g-1.  The chains of a pass are
+// divided among the threads, with a barrier between passes.  Once the gap
+// is too small to give each thread a worthwhile number of chains, the
+// calling thread finishes the remaining passes alone.
+
+// A thread's share of a pass must be at least this many chains.
+// Adjacent chains share cache lines, so small shares would cause false sharing.
+const int64_t PAR_SHELL_MIN_CHAINS = 256;
+
+// Insertion-sort chains chainFirst..chainLast-1 of the pass with this gap.
+// Elements are visited in increasing index order, as in shellSort(), so
+// neighbouring chains move through memory together.
+template<typename T, typename Greater>
+void shellSortChainsT(T a[], int64_t n, int64_t gap, int64_t chainFirst, int64_t chainLast, Greater gt)
+{
+    for(int64_t rowStart=gap; rowStart<n; rowStart+=gap) {
+        int64_t iEnd = rowStart + chainLast;
+        if(iEnd > n) iEnd = n;
+        for(int64_t i=rowStart+chainFirst; i<iEnd; i++) {
+            T temp = a[i];
+            int64_t j;
+            for(j=i; (j>=gap) && gt(a[j-gap], temp); j -= gap) {
+                a[j] = a[j-gap];
+            }
+            a[j] = temp;
+        }
+    }
+}
+
+// Sort an array using Shellsort on nThreads threads.
+// Entry:   a, n, gaps are as for shellSort().
+//          nThreads is the number of threads to use, including the caller.
+// Exit:    a   has been sorted in increasing order.
+template<typename T, typename Greater>
+void parallelShellSortT(T a[], int64_t n, const int64_t gaps[], int nThreads, Greater gt)
+{
+    int64_t igap;
+    if(n <= 1) return;
+    if(nThreads < 1) nThreads = 1;
+
+    // Find the gap to start with.
+    for(igap=0; gaps[igap]<n && gaps[igap]>0; igap++);
+    igap--;
+
+    // Passes igap down to igapParallelEnd+1 are done in parallel.
+    int64_t igapParallelEnd = igap;
+    while(igapParallelEnd >= 0 && gaps[igapParallelEnd] >= nThreads*PAR_SHELL_MIN_CHAINS) {
+        igapParallelEnd--;
+    }
+
+    if(nThreads > 1 && igapParallelEnd < igap) {
+        std::barrier<> passDone(nThreads);
+        auto worker = [&](int ithread) {
+            for(int64_t ig=igap; ig>igapParallelEnd; ig--) {
+                int64_t gap = gaps[ig];
+                shellSortChainsT(a, n, gap, ithread*gap/nThreads, (ithread+1)*gap/nThreads, gt);
+                passDone.arrive_and_wait();
+            }
+        };
+        std::vector<std::thread> threads;
+        for(int ithread=1; ithread<nThreads; ithread++) {
+            threads.emplace_back(worker, ithread);
+        }
+        worker(0);
+        for(std::thread &thr : threads) {
+            thr.join();
+        }
+        igap = igapParallelEnd;
+    }
+
+    for(; igap>=0; igap--) {
+        shellSortChainsT(a, n, gaps[igap], 0, gaps[igap], gt);
+    }
+}
+
+//=====  Parallel merge sort  =========================================
+// Fork-join merge sort on a work-stealing TaskPool.  Each level sorts its
+// left half as a task, which an idle thread may steal, while it sorts the
+// right half itself.  The merges are parallel too: the larger input is
+// split at its middle element, the other input at the same key, and the
+// two smaller merges proceed independently, so the top-level merge does
+// not run on one core.  Halves alternate between the array and a buffer
+// of n elements, so each element is copied once per level.
+
+// Pieces smaller than this are sorted by one thread with pdqsort.
+const int64_t PAR_MERGE_SORT_LEAF = 8192;
+// Merges with fewer output elements than this are not split further.
+const int64_t PAR_MERGE_LEAF = 16384;
+
+// Merge sorted a[0..na-1] and b[0..nb-1] into out.
+template<typename T, typename Greater>
+void parallelMergeT(TaskPool *pool, int iworker, const T a[], int64_t na, const T b[], int64_t nb,
+                    T out[], Greater gt)
+{
+    if(na + nb <= PAR_MERGE_LEAF) {
+        int64_t i=0, j=0, k=0;
+        while(i<na && j<nb) {
+            if(gt(a[i], b[j])) {
+                out[k++] = b[j++];
+            } else {
+                out[k++] = a[i++];
+            }
+        }
+        while(i<na) out[k++] = a[i++];
+        while(j<nb) out[k++] = b[j++];
+        return;
+    }
+    if(na < nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    // Everything before a[ma] and b[mb] sorts no later than everything after.
+    int64_t ma = na/2;
+    int64_t mb = std::lower_bound(b, b+nb, a[ma], [gt](const T &x, const T &y) { return gt(y, x); }) - b;
+    TaskGroup group;
+    taskPoolSpawn(pool, iworker, &group, [=](int iw) {
+        parallelMergeT(pool, iw, a, ma, b, mb, out, gt);
+    });
+    parallelMergeT(pool, iworker, a+ma, na-ma, b+mb, nb-mb, out+ma+mb, gt);
+    taskPoolWait(pool, iworker, &group);
+}
+
+// Sort a[0..n-1], leaving the result in a, or in buf if bToBuf.
+template<typename T, typename Greater>
+void parallelMergeSortRecT(TaskPool *pool, int iworker, T a[], T buf[], int64_t n, bool bToBuf, Greater gt)
+{
+    if(n <= PAR_MERGE_SORT_LEAF) {
+        pdqSortT(a, n, gt);
+        if(bToBuf) std::copy(a, a+n, buf);
+        return;
+    }
+    int64_t mid = n/2;
+    TaskGroup group;
+    taskPoolSpawn(pool, iworker, &group, [=](int iw) {
+        parallelMergeSortRecT(pool, iw, a, buf, mid, !bToBuf, gt);
+    });
+    parallelMergeSortRecT(pool, iworker, a+mid, buf+mid, n-mid, !bToBuf, gt);
+    taskPoolWait(pool, iworker, &group);
+    if(bToBuf) {
+        parallelMergeT(pool, iworker, a, mid, a+mid, n-mid, buf, gt);
+    } else {
+        parallelMergeT(pool, iworker, buf, mid, buf+mid, n-mid, a, gt);
+    }
+}
+
+// Sort an array with merge sort on nThreads threads, including the caller.
+// Exit:    a   has been sorted in increasing order.
+template<typename T, typename Greater>
+void parallelMergeSortT(T a[], int64_t n, int nThreads, Greater gt)
+{
+    if(n <= 1) return;
+    if(n <= PAR_MERGE_SORT_LEAF) {
+        pdqSortT(a, n, gt);
+        return;
+    }
+    T *buf = new T[n];
+    TaskPool pool;
+    taskPoolStart(&pool, nThreads);
+    parallelMergeSortRecT(&pool, 0, a, buf, n, false, gt);
+    taskPoolStop(&pool);
+    delete []buf;
+}
+
+#endif /* parallelsort_h */
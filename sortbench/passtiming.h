@@ -0,0 +1,50 @@
+//
+//  passtiming.h
+//  sortbench
+//
+//  Timing of each gap pass of a Shellsort, for -passes.  A sort run with
+//  TimingPassHook leaves the time of each pass, and optionally hardware
+//  counts, in passTimes, so that the memory-bound large-gap passes can be
+//  told apart from the final small-gap ones.
+//
+
+#ifndef passtiming_h
+#define passtiming_h
+
+#include <stdint.h>
+#include <vector>
+#include "timer.h"
+#include "perfcounters.h"
+
+struct TypPassTimes {
+    int64_t     gap;
+    sb_timer_t  elapsedNs;
+    TypPerfCounts perfCounts;   // Valid only if passPerfSet was set.
+};
+
+// Per-pass times of the last timed Shellsort, largest gap first.
+// Callers should reserve room so that recording a pass doesn't allocate.
+extern std::vector<TypPassTimes> passTimes;
+// Counters to read around each pass, or NULL.
+extern PerfCounterSet *passPerfSet;
+
+// Shellsort pass hook (see NoShellPassHook) that records the time of each
+// pass in passTimes.  The counters are started before the timer and
+// stopped after it, so that their system calls are not timed.
+struct TimingPassHook {
+    uint64_t start = 0;
+
+    void beginPass(int64_t gap) {
+        if(NULL != passPerfSet) perfStart(passPerfSet);
+        start = timerStart();
+    }
+    void endPass(int64_t gap) {
+        TypPassTimes times;
+        times.gap = gap;
+        times.elapsedNs = timerElapsedNs(start);
+        if(NULL != passPerfSet) perfStop(passPerfSet, &times.perfCounts);
+        passTimes.push_back(times);
+    }
+};
+
+#endif /* passtiming_h */
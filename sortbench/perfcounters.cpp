@@ -0,0 +1,147 @@
+//
+//  perfcounters.cpp
+//  sortbench
+//
+
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+const char *nameOfPerfCounter(TypPerfCounter counter)
+{
+    const char *names[PERF_NUM_COUNTERS] = {
+        "cycles", "instructions", "l1dmisses", "llcmisses", "branchmisses", "dtlbmisses"
+    };
+    return counter < PERF_NUM_COUNTERS ? names[counter] : "unknown";
+}
+
+#ifdef __linux__
+
+static int perfEventOpen(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    // Count only user code, which works with the default perf_event_paranoid,
+    // and include threads the sort starts, such as ParShellSort's.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t cacheMissConfig(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+bool perfOpen(PerfCounterSet *pSet)
+{
+    pSet->fds[PERF_CYCLES] = perfEventOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pSet->fds[PERF_INSTRUCTIONS] = perfEventOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pSet->fds[PERF_L1D_MISSES] = perfEventOpen(PERF_TYPE_HW_CACHE, cacheMissConfig(PERF_COUNT_HW_CACHE_L1D));
+    pSet->fds[PERF_LLC_MISSES] = perfEventOpen(PERF_TYPE_HW_CACHE, cacheMissConfig(PERF_COUNT_HW_CACHE_LL));
+    pSet->fds[PERF_BRANCH_MISSES] = perfEventOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    pSet->fds[PERF_DTLB_MISSES] = perfEventOpen(PERF_TYPE_HW_CACHE, cacheMissConfig(PERF_COUNT_HW_CACHE_DTLB));
+    pSet->bOpen = false;
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        if(pSet->fds[j] >= 0) pSet->bOpen = true;
+    }
+    return pSet->bOpen;
+}
+
+void perfClose(PerfCounterSet *pSet)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        if(pSet->fds[j] >= 0) close(pSet->fds[j]);
+        pSet->fds[j] = -1;
+    }
+    pSet->bOpen = false;
+}
+
+// Read value, time enabled and time running.  Each includes the counts
+// of inherited threads, which PERF_EVENT_IOC_RESET does not zero once the
+// threads have exited, so regions are measured as differences of reads.
+static bool perfRead(int fd, uint64_t values[3])
+{
+    return fd >= 0 && 3*sizeof(uint64_t) == read(fd, values, 3*sizeof(uint64_t));
+}
+
+void perfStart(PerfCounterSet *pSet)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        if(!perfRead(pSet->fds[j], pSet->startValues[j])) {
+            memset(pSet->startValues[j], 0, sizeof(pSet->startValues[j]));
+        }
+    }
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        if(pSet->fds[j] >= 0) ioctl(pSet->fds[j], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perfStop(PerfCounterSet *pSet, TypPerfCounts *pCounts)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        if(pSet->fds[j] >= 0) ioctl(pSet->fds[j], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        uint64_t values[3];
+        pCounts->counts[j] = -1;
+        if(perfRead(pSet->fds[j], values)) {
+            for(int k=0; k<3; k++) {
+                values[k] -= pSet->startValues[j][k];
+            }
+            if(values[2] > 0 && values[2] < values[1]) {
+                // The counter was multiplexed; extrapolate to the whole region.
+                values[0] = (uint64_t)((double)values[0] * values[1] / values[2]);
+            }
+            pCounts->counts[j] = (int64_t) values[0];
+        }
+    }
+}
+
+#else
+
+bool perfOpen(PerfCounterSet *pSet)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        pSet->fds[j] = -1;
+    }
+    pSet->bOpen = false;
+    return false;
+}
+
+void perfClose(PerfCounterSet *pSet)
+{
+    pSet->bOpen = false;
+}
+
+void perfStart(PerfCounterSet *pSet)
+{
+}
+
+void perfStop(PerfCounterSet *pSet, TypPerfCounts *pCounts)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        pCounts->counts[j] = -1;
+    }
+}
+
+#endif
+
+void perfWriteCSV(FILE *file, const TypPerfCounts *pCounts)
+{
+    for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+        fprintf(file, ",%lld", (long long) pCounts->counts[j]);
+    }
+}
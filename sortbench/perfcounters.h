@@ -0,0 +1,45 @@
+//
+//  perfcounters.h
+//  sortbench
+//
+//  Hardware performance counters around a timed region, using Linux
+//  perf_event_open.  On other systems perfOpen() simply fails.
+//
+
+#ifndef perfcounters_h
+#define perfcounters_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum TypPerfCounter {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES, PERF_DTLB_MISSES, PERF_NUM_COUNTERS};
+
+// Counts for one region.  A counter the CPU or kernel doesn't provide is -1.
+struct TypPerfCounts {
+    int64_t counts[PERF_NUM_COUNTERS];
+};
+
+// The open counters for the calling thread, and threads it creates later.
+struct PerfCounterSet {
+    int     fds[PERF_NUM_COUNTERS];
+    bool    bOpen = false;
+    // Value, time enabled and time running of each counter at perfStart.
+    uint64_t startValues[PERF_NUM_COUNTERS][3];
+};
+
+const char *nameOfPerfCounter(TypPerfCounter counter);
+
+// Open the counters.  Returns false if none could be opened.
+bool perfOpen(PerfCounterSet *pSet);
+void perfClose(PerfCounterSet *pSet);
+// Start the counters, noting their values.
+void perfStart(PerfCounterSet *pSet);
+// Stop the counters and read how far they advanced since perfStart,
+// scaling for any multiplexing.
+void perfStop(PerfCounterSet *pSet, TypPerfCounts *pCounts);
+
+// Write the counts as CSV fields, each preceded by a comma.
+void perfWriteCSV(FILE *file, const TypPerfCounts *pCounts);
+
+#endif /* perfcounters_h */
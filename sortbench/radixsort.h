@@ -0,0 +1,200 @@
+//
+//  radixsort.h
+//  sortbench
+//
+//  Radix sort engine.  Keys are the first keyLen bytes returned by a
+//  KeyOf functor, compared as unsigned bytes, as by memcmp().
+//  If every key byte comes from a small alphabet, the keys are packed
+//  into integers (5 bits per byte for a 32-symbol alphabet) and sorted
+//  with LSD passes over digits of a chosen width.  Otherwise an MSD
+//  byte-at-a-time radix sort is used, which handles any bytes.
+//
+
+#ifndef radixsort_h
+#define radixsort_h
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+const int RADIX_MIN_DIGIT_BITS = 5;
+const int RADIX_MAX_DIGIT_BITS = 11;
+// MSD buckets smaller than this are finished with insertion sort.
+const int64_t MSD_INSERTION_THRESHOLD = 32;
+
+template<typename T>
+struct RadixItem {
+    uint64_t    key;
+    T           elem;
+};
+
+// Compare keys from byte pos onward.
+inline bool radixKeyGreaterFrom(const unsigned char *first, const unsigned char *second, int pos, int keyLen)
+{
+    for(int j=pos; j<keyLen; j++) {
+        if(first[j] != second[j]) return first[j] > second[j];
+    }
+    return false;
+}
+
+//=====  Packed-key LSD path  =========================================
+
+// Describes how to pack keys drawn from an alphabet into integers.
+struct RadixAlphabet {
+    int     bitsPerSymbol = 0;
+    int16_t codes[256];     // Rank of each byte within the alphabet, or -1.
+};
+
+// Build the packing table for an alphabet.  Codes are assigned in byte
+// order, so comparing packed keys as integers matches memcmp().
+inline void buildRadixAlphabet(const char *alphabet, RadixAlphabet &alpha)
+{
+    bool bPresent[256] = {false};
+    for(const char *pch=alphabet; '\0' != *pch; pch++) {
+        bPresent[(unsigned char) *pch] = true;
+    }
+    int nSymbols = 0;
+    for(int ch=0; ch<256; ch++) {
+        alpha.codes[ch] = bPresent[ch] ? nSymbols++ : -1;
+    }
+    alpha.bitsPerSymbol = 0;
+    while((1 << alpha.bitsPerSymbol) < nSymbols) {
+        alpha.bitsPerSymbol++;
+    }
+}
+
+// Pack each key into items[].key.  Returns false if some key has a byte
+// outside the alphabet, in which case the caller must use the MSD path.
+template<typename T, typename KeyOf>
+bool radixPackKeys(T a[], int64_t n, int keyLen, const RadixAlphabet &alpha,
+                   RadixItem<T> items[], KeyOf keyOf)
+{
+    for(int64_t i=0; i<n; i++) {
+        const unsigned char *key = keyOf(a[i]);
+        uint64_t packed = 0;
+        for(int j=0; j<keyLen; j++) {
+            int code = alpha.codes[key[j]];
+            if(code < 0) return false;
+            packed = (packed << alpha.bitsPerSymbol) | code;
+        }
+        items[i].key = packed;
+        items[i].elem = a[i];
+    }
+    return true;
+}
+
+// Stable LSD radix sort of items[] on the low totalBits bits of the keys,
+// digitBits at a time.  Histograms for all passes are gathered in one scan,
+// and passes in which every key has the same digit are skipped.
+// Returns the array that holds the result: items or tmp.
+template<typename T>
+RadixItem<T> *lsdRadixSortItems(RadixItem<T> items[], RadixItem<T> tmp[], int64_t n,
+                                int totalBits, int digitBits)
+{
+    int nPasses = (totalBits + digitBits - 1) / digitBits;
+    int64_t nBuckets = (int64_t)1 << digitBits;
+    uint64_t mask = nBuckets - 1;
+    std::vector<int64_t> counts(nPasses * nBuckets, 0);
+    for(int64_t i=0; i<n; i++) {
+        uint64_t key = items[i].key;
+        for(int pass=0; pass<nPasses; pass++) {
+            counts[pass*nBuckets + ((key >> (pass*digitBits)) & mask)]++;
+        }
+    }
+
+    RadixItem<T> *src = items, *dst = tmp;
+    for(int pass=0; pass<nPasses; pass++) {
+        int64_t *count = &counts[pass*nBuckets];
+        int shift = pass*digitBits;
+        if(count[(src[0].key >> shift) & mask] == n) continue;
+        int64_t sum = 0;
+        for(int64_t b=0; b<nBuckets; b++) {
+            int64_t c = count[b];
+            count[b] = sum;
+            sum += c;
+        }
+        for(int64_t i=0; i<n; i++) {
+            dst[count[(src[i].key >> shift) & mask]++] = src[i];
+        }
+        RadixItem<T> *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return src;
+}
+
+//=====  General MSD path  ============================================
+
+// Sort a[0..n-1] on key bytes pos..keyLen-1.  All keys in a[] have equal
+// bytes before pos.  aux must have room for n elements.
+template<typename T, typename KeyOf>
+void msdRadixSortT(T a[], T aux[], int64_t n, int keyLen, int pos, KeyOf keyOf)
+{
+    if(pos >= keyLen || n <= 1) return;
+    if(n < MSD_INSERTION_THRESHOLD) {
+        for(int64_t i=1; i<n; i++) {
+            T temp = a[i];
+            int64_t j;
+            for(j=i; j>0 && radixKeyGreaterFrom(keyOf(a[j-1]), keyOf(temp), pos, keyLen); j--) {
+                a[j] = a[j-1];
+            }
+            a[j] = temp;
+        }
+        return;
+    }
+
+    int64_t count[256] = {0};
+    for(int64_t i=0; i<n; i++) {
+        count[keyOf(a[i])[pos]]++;
+    }
+    int64_t start[256], next[256];
+    int64_t sum = 0;
+    for(int b=0; b<256; b++) {
+        start[b] = next[b] = sum;
+        sum += count[b];
+    }
+    for(int64_t i=0; i<n; i++) {
+        aux[next[keyOf(a[i])[pos]]++] = a[i];
+    }
+    std::copy(aux, aux+n, a);
+    for(int b=0; b<256; b++) {
+        if(count[b] > 1) {
+            msdRadixSortT(a+start[b], aux+start[b], count[b], keyLen, pos+1, keyOf);
+        }
+    }
+}
+
+//=====  Entry point  =================================================
+
+// Sort a[0..n-1] by key.
+// Entry:   alphabet    is the set of bytes keys are expected to use.
+//          digitBits   is the LSD digit width, RADIX_MIN_DIGIT_BITS to
+//                      RADIX_MAX_DIGIT_BITS.
+//          keyOf       returns a pointer to an element's key bytes.
+template<typename T, typename KeyOf>
+void radixSortT(T a[], int64_t n, int keyLen, const char *alphabet, int digitBits, KeyOf keyOf)
+{
+    if(n <= 1) return;
+    RadixAlphabet alpha;
+    buildRadixAlphabet(alphabet, alpha);
+    int totalBits = keyLen * alpha.bitsPerSymbol;
+    if(totalBits > 0 && totalBits <= 64) {
+        RadixItem<T> *items = new RadixItem<T>[n];
+        if(radixPackKeys(a, n, keyLen, alpha, items, keyOf)) {
+            RadixItem<T> *tmp = new RadixItem<T>[n];
+            RadixItem<T> *sorted = lsdRadixSortItems(items, tmp, n, totalBits, digitBits);
+            for(int64_t i=0; i<n; i++) {
+                a[i] = sorted[i].elem;
+            }
+            delete []tmp;
+            delete []items;
+            return;
+        }
+        delete []items;
+    }
+    T *aux = new T[n];
+    msdRadixSortT(a, aux, n, keyLen, 0, keyOf);
+    delete []aux;
+}
+
+#endif /* radixsort_h */
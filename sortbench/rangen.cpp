@@ -223,6 +223,214 @@ void md5_finalize(struct md5_context* ctx, struct md5_digest* digest) {
     digest->bytes[15] = (uint8_t)(ctx->d >> 24);
 }
 
+//=====  Multi-lane MD5 of counter blocks  ============================
+// Each block of the random stream is the MD5 of one 8-byte counter, so the
+// padded message is the same for every block except words 0 and 1.  The
+// kernels below hash 4, 8 or 16 consecutive counters at once, one per
+// vector lane, using the compiler's vector extensions.  On x86 they are
+// compiled for SSE2, AVX2 and AVX-512F and chosen at run time; the result
+// is bit-identical to md5_init/md5_update/md5_finalize.
+
+// Message words of the padded 8-byte message, other than the counter.
+#define MW_0 w0
+#define MW_1 w1
+#define MW_2 0x80u
+#define MW_3 0u
+#define MW_4 0u
+#define MW_5 0u
+#define MW_6 0u
+#define MW_7 0u
+#define MW_8 0u
+#define MW_9 0u
+#define MW_10 0u
+#define MW_11 0u
+#define MW_12 0u
+#define MW_13 0u
+#define MW_14 64u
+#define MW_15 0u
+
+// Compute MD5(firstCounter+lane) for each of NLANES lanes of vector type V.
+template<typename V, int NLANES>
+static inline __attribute__((always_inline))
+void md5CounterLanesT(int64_t firstCounter, md5_digest out[])
+{
+    V w0, w1;
+    for(int lane=0; lane<NLANES; lane++) {
+        uint64_t counter = (uint64_t)firstCounter + lane;
+        w0[lane] = (uint32_t)counter;
+        w1[lane] = (uint32_t)(counter >> 32);
+    }
+    const V zero = {};
+    V a = zero + 0x67452301u;
+    V b = zero + 0xefcdab89u;
+    V c = zero + 0x98badcfeu;
+    V d = zero + 0x10325476u;
+
+    STEP(F, a, b, c, d, MW_0, 0xd76aa478, 7);
+    STEP(F, d, a, b, c, MW_1, 0xe8c7b756, 12);
+    STEP(F, c, d, a, b, MW_2, 0x242070db, 17);
+    STEP(F, b, c, d, a, MW_3, 0xc1bdceee, 22);
+    STEP(F, a, b, c, d, MW_4, 0xf57c0faf, 7);
+    STEP(F, d, a, b, c, MW_5, 0x4787c62a, 12);
+    STEP(F, c, d, a, b, MW_6, 0xa8304613, 17);
+    STEP(F, b, c, d, a, MW_7, 0xfd469501, 22);
+    STEP(F, a, b, c, d, MW_8, 0x698098d8, 7);
+    STEP(F, d, a, b, c, MW_9, 0x8b44f7af, 12);
+    STEP(F, c, d, a, b, MW_10, 0xffff5bb1, 17);
+    STEP(F, b, c, d, a, MW_11, 0x895cd7be, 22);
+    STEP(F, a, b, c, d, MW_12, 0x6b901122, 7);
+    STEP(F, d, a, b, c, MW_13, 0xfd987193, 12);
+    STEP(F, c, d, a, b, MW_14, 0xa679438e, 17);
+    STEP(F, b, c, d, a, MW_15, 0x49b40821, 22);
+
+    STEP(G, a, b, c, d, MW_1, 0xf61e2562, 5);
+    STEP(G, d, a, b, c, MW_6, 0xc040b340, 9);
+    STEP(G, c, d, a, b, MW_11, 0x265e5a51, 14);
+    STEP(G, b, c, d, a, MW_0, 0xe9b6c7aa, 20);
+    STEP(G, a, b, c, d, MW_5, 0xd62f105d, 5);
+    STEP(G, d, a, b, c, MW_10, 0x02441453, 9);
+    STEP(G, c, d, a, b, MW_15, 0xd8a1e681, 14);
+    STEP(G, b, c, d, a, MW_4, 0xe7d3fbc8, 20);
+    STEP(G, a, b, c, d, MW_9, 0x21e1cde6, 5);
+    STEP(G, d, a, b, c, MW_14, 0xc33707d6, 9);
+    STEP(G, c, d, a, b, MW_3, 0xf4d50d87, 14);
+    STEP(G, b, c, d, a, MW_8, 0x455a14ed, 20);
+    STEP(G, a, b, c, d, MW_13, 0xa9e3e905, 5);
+    STEP(G, d, a, b, c, MW_2, 0xfcefa3f8, 9);
+    STEP(G, c, d, a, b, MW_7, 0x676f02d9, 14);
+    STEP(G, b, c, d, a, MW_12, 0x8d2a4c8a, 20);
+
+    STEP(H, a, b, c, d, MW_5, 0xfffa3942, 4);
+    STEP(H, d, a, b, c, MW_8, 0x8771f681, 11);
+    STEP(H, c, d, a, b, MW_11, 0x6d9d6122, 16);
+    STEP(H, b, c, d, a, MW_14, 0xfde5380c, 23);
+    STEP(H, a, b, c, d, MW_1, 0xa4beea44, 4);
+    STEP(H, d, a, b, c, MW_4, 0x4bdecfa9, 11);
+    STEP(H, c, d, a, b, MW_7, 0xf6bb4b60, 16);
+    STEP(H, b, c, d, a, MW_10, 0xbebfbc70, 23);
+    STEP(H, a, b, c, d, MW_13, 0x289b7ec6, 4);
+    STEP(H, d, a, b, c, MW_0, 0xeaa127fa, 11);
+    STEP(H, c, d, a, b, MW_3, 0xd4ef3085, 16);
+    STEP(H, b, c, d, a, MW_6, 0x04881d05, 23);
+    STEP(H, a, b, c, d, MW_9, 0xd9d4d039, 4);
+    STEP(H, d, a, b, c, MW_12, 0xe6db99e5, 11);
+    STEP(H, c, d, a, b, MW_15, 0x1fa27cf8, 16);
+    STEP(H, b, c, d, a, MW_2, 0xc4ac5665, 23);
+
+    STEP(I, a, b, c, d, MW_0, 0xf4292244, 6);
+    STEP(I, d, a, b, c, MW_7, 0x432aff97, 10);
+    STEP(I, c, d, a, b, MW_14, 0xab9423a7, 15);
+    STEP(I, b, c, d, a, MW_5, 0xfc93a039, 21);
+    STEP(I, a, b, c, d, MW_12, 0x655b59c3, 6);
+    STEP(I, d, a, b, c, MW_3, 0x8f0ccc92, 10);
+    STEP(I, c, d, a, b, MW_10, 0xffeff47d, 15);
+    STEP(I, b, c, d, a, MW_1, 0x85845dd1, 21);
+    STEP(I, a, b, c, d, MW_8, 0x6fa87e4f, 6);
+    STEP(I, d, a, b, c, MW_15, 0xfe2ce6e0, 10);
+    STEP(I, c, d, a, b, MW_6, 0xa3014314, 15);
+    STEP(I, b, c, d, a, MW_13, 0x4e0811a1, 21);
+    STEP(I, a, b, c, d, MW_4, 0xf7537e82, 6);
+    STEP(I, d, a, b, c, MW_11, 0xbd3af235, 10);
+    STEP(I, c, d, a, b, MW_2, 0x2ad7d2bb, 15);
+    STEP(I, b, c, d, a, MW_9, 0xeb86d391, 21);
+
+    a += 0x67452301u;
+    b += 0xefcdab89u;
+    c += 0x98badcfeu;
+    d += 0x10325476u;
+
+    for(int lane=0; lane<NLANES; lane++) {
+        uint32_t words[4] = {a[lane], b[lane], c[lane], d[lane]};
+        for(int j=0; j<MD5_HASH_SIZE; j++) {
+            out[lane].bytes[j] = (uint8_t)(words[j/4] >> (8*(j%4)));
+        }
+    }
+}
+
+typedef uint32_t md5_v4 __attribute__((vector_size(16)));
+typedef uint32_t md5_v8 __attribute__((vector_size(32)));
+typedef uint32_t md5_v16 __attribute__((vector_size(64)));
+
+typedef void (*md5_lanes_func)(int64_t firstCounter, md5_digest out[]);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MD5_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MD5_TARGET(isa)
+#endif
+
+static MD5_TARGET("sse2") void md5CounterLanes4(int64_t firstCounter, md5_digest out[])
+{
+    md5CounterLanesT<md5_v4, 4>(firstCounter, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static MD5_TARGET("avx2") void md5CounterLanes8(int64_t firstCounter, md5_digest out[])
+{
+    md5CounterLanesT<md5_v8, 8>(firstCounter, out);
+}
+
+static MD5_TARGET("avx512f") void md5CounterLanes16(int64_t firstCounter, md5_digest out[])
+{
+    md5CounterLanesT<md5_v16, 16>(firstCounter, out);
+}
+#endif
+
+// Returns true if this CPU can run the kernel with the given lane count.
+static bool md5LanesSupported(int lanes)
+{
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    // The kernels assume the counter is hashed in little-endian order.
+    return 1 == lanes;
+#elif defined(__x86_64__) || defined(__i386__)
+    switch(lanes) {
+        case 1:  return true;
+        case 4:  return __builtin_cpu_supports("sse2");
+        case 8:  return __builtin_cpu_supports("avx2");
+        case 16: return __builtin_cpu_supports("avx512f");
+        default: return false;
+    }
+#else
+    return 1 == lanes || 4 == lanes;
+#endif
+}
+
+static int md5BestLanes()
+{
+    const int candidates[] = {16, 8, 4};
+    for(int lanes : candidates) {
+        if(md5LanesSupported(lanes)) return lanes;
+    }
+    return 1;
+}
+
+static int md5Lanes = md5BestLanes();
+
+int myRandomLanes()
+{
+    return md5Lanes;
+}
+
+bool mySetRandomLanes(int lanes)
+{
+    if(0 == lanes) lanes = md5BestLanes();
+    if(!md5LanesSupported(lanes)) return false;
+    md5Lanes = lanes;
+    return true;
+}
+
+static md5_lanes_func md5LanesFunc(int lanes)
+{
+    switch(lanes) {
+        case 4:  return md5CounterLanes4;
+#if defined(__x86_64__) || defined(__i386__)
+        case 8:  return md5CounterLanes8;
+        case 16: return md5CounterLanes16;
+#endif
+        default: return NULL;
+    }
+}
+
 void genNextDigest(myRandomContext *myctx)
 {
     md5_init(&myctx->md_context);
@@ -235,6 +443,7 @@ void genNextDigest(myRandomContext *myctx)
 void mySetRandomSeed(myRandomContext *myctx, uint64_t seed)
 {
     myctx->md_seed = seed;
+    myctx->md_origin = seed;
     genNextDigest(myctx);
 }
 
@@ -247,3 +456,60 @@ unsigned char myNextRandomByte(myRandomContext *myctx)
     unsigned char result = myctx->md_digest.bytes[myctx->md_bytes_left];
     return result;
 }
+
+// Returns the number of bytes taken from the stream since mySetRandomSeed.
+uint64_t myRandomPosition(const myRandomContext *myctx)
+{
+    uint64_t block = (uint64_t)(myctx->md_seed - myctx->md_origin - 1);
+    return block*MD5_HASH_SIZE + (MD5_HASH_SIZE - myctx->md_bytes_left);
+}
+
+// Position the stream so that the next byte returned is byte pos of the
+// stream for the current seed.
+void mySeekRandom(myRandomContext *myctx, uint64_t pos)
+{
+    myctx->md_seed = myctx->md_origin + (int64_t)(pos / MD5_HASH_SIZE);
+    genNextDigest(myctx);
+    myctx->md_bytes_left -= (int)(pos % MD5_HASH_SIZE);
+}
+
+// Fill buf with the next len bytes of the stream.  The result is the same
+// as len calls to myNextRandomByte, but whole digests are copied at once.
+void myRandomBytes(myRandomContext *myctx, unsigned char *buf, uint64_t len)
+{
+    while(len > 0) {
+        if(myctx->md_bytes_left <= 0) {
+            genNextDigest(myctx);
+        }
+        uint64_t nCopy = myctx->md_bytes_left;
+        if(nCopy > len) nCopy = len;
+        const unsigned char *digest = myctx->md_digest.bytes;
+        int left = myctx->md_bytes_left;
+        for(uint64_t j=0; j<nCopy; j++) {
+            buf[j] = digest[--left];
+        }
+        myctx->md_bytes_left = left;
+        buf += nCopy;
+        len -= nCopy;
+
+        // Hash runs of whole blocks several at a time.
+        int lanes = md5Lanes;
+        md5_lanes_func func = md5LanesFunc(lanes);
+        if(NULL != func && len >= (uint64_t)lanes*MD5_HASH_SIZE) {
+            md5_digest digests[16];
+            while(len >= (uint64_t)lanes*MD5_HASH_SIZE) {
+                func(myctx->md_seed + 1, digests);
+                for(int lane=0; lane<lanes; lane++) {
+                    for(int j=0; j<MD5_HASH_SIZE; j++) {
+                        buf[j] = digests[lane].bytes[MD5_HASH_SIZE-1-j];
+                    }
+                    buf += MD5_HASH_SIZE;
+                }
+                len -= lanes*MD5_HASH_SIZE;
+                myctx->md_seed += lanes;
+            }
+            myctx->md_digest = digests[lanes-1];
+            myctx->md_bytes_left = 0;
+        }
+    }
+}
@@ -30,14 +30,30 @@ struct md5_digest {
     unsigned char bytes[MD5_HASH_SIZE];
 };
 
+// The random stream for a seed is MD5(seed+1), MD5(seed+2), ..., each
+// digest's bytes taken last to first.  Because block k depends only on
+// seed and k, any position in the stream can be computed directly.
 struct myRandomContext {
     md5_context     md_context;
     md5_digest      md_digest;
     int64_t         md_seed;
     int             md_bytes_left;
+    int64_t         md_origin;      // seed passed to mySetRandomSeed
 };
 
 void mySetRandomSeed(myRandomContext *myctx, uint64_t seed);
 unsigned char myNextRandomByte(myRandomContext *myctx);
 
+// Bulk and random-access use of the same stream.
+uint64_t myRandomPosition(const myRandomContext *myctx);
+void mySeekRandom(myRandomContext *myctx, uint64_t pos);
+void myRandomBytes(myRandomContext *myctx, unsigned char *buf, uint64_t len);
+
+// Number of MD5 blocks myRandomBytes hashes at once: 1 (scalar), 4 (SSE2),
+// 8 (AVX2) or 16 (AVX-512).  The best the CPU supports is chosen at startup.
+// mySetRandomLanes(0) restores that choice; it returns false if the CPU
+// can't run the requested kernel.
+int myRandomLanes();
+bool mySetRandomLanes(int lanes);
+
 #endif /* rangen_h */
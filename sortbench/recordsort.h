@@ -0,0 +1,133 @@
+//
+//  recordsort.h
+//  sortbench
+//
+//  Sorting records of a chosen size by moving the records themselves,
+//  and putting records into the order of a sorted pointer array.
+//  Records are recSize bytes, stored contiguously; keys are compared by
+//  a KeyGreater functor given the address of each record.  Common sizes
+//  are compiled as fixed-size types so that moves are inline copies; any
+//  other size uses memcpy with a runtime length.
+//
+
+#ifndef recordsort_h
+#define recordsort_h
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "sortengines.h"
+
+const int RECORD_SIZE_MIN = 8;
+const int RECORD_SIZE_MAX = 4096;
+
+// Record sizes with their own instantiations.
+#define FOR_EACH_FIXED_RECORD_SIZE(X) \
+    X(8) X(16) X(32) X(64) X(72) X(128) X(256) X(512) X(1024) X(2048) X(4096)
+
+template<int SIZE>
+struct SizedRecord {
+    char data[SIZE];
+};
+
+template<int SIZE, typename KeyGreater>
+struct SizedRecordGreater {
+    KeyGreater keyGt;
+    bool operator()(const SizedRecord<SIZE> &first, const SizedRecord<SIZE> &second) const {
+        return keyGt(first.data, second.data);
+    }
+};
+
+//=====  Shellsort moving records  ====================================
+
+// Shellsort on records of any size, as shellSort() does on pointers.
+template<typename KeyGreater>
+void shellSortRecordsVar(char *base, int64_t n, size_t recSize, const int64_t gaps[], KeyGreater keyGt)
+{
+    int64_t igap;
+    if(n <= 1) return;
+    std::vector<char> temp(recSize);
+    for(igap=0; gaps[igap]<n && gaps[igap]>0; igap++);
+    igap--;
+    for(; igap>=0; igap--) {
+        int64_t gap = gaps[igap];
+        for(int64_t i=gap; i<n; i++) {
+            memcpy(temp.data(), base + i*recSize, recSize);
+            int64_t j;
+            for(j=i; (j>=gap) && keyGt(base + (j-gap)*recSize, temp.data()); j -= gap) {
+                memcpy(base + j*recSize, base + (j-gap)*recSize, recSize);
+            }
+            memcpy(base + j*recSize, temp.data(), recSize);
+        }
+    }
+}
+
+// Sort n records of recSize bytes in place with Shellsort.
+template<typename KeyGreater>
+void shellSortRecords(char *base, int64_t n, size_t recSize, const int64_t gaps[], KeyGreater keyGt)
+{
+    switch(recSize) {
+#define SHELL_SORT_RECORDS_CASE(SIZE) \
+        case SIZE: \
+            shellSortT((SizedRecord<SIZE> *) base, n, gaps, SizedRecordGreater<SIZE, KeyGreater>{keyGt}); \
+            return;
+        FOR_EACH_FIXED_RECORD_SIZE(SHELL_SORT_RECORDS_CASE)
+#undef SHELL_SORT_RECORDS_CASE
+    }
+    shellSortRecordsVar(base, n, recSize, gaps, keyGt);
+}
+
+//=====  Physical permutation  ========================================
+// After a pointer sort, the records are gathered into a second array in
+// sorted order.  The writes are sequential, but the reads are scattered,
+// so the output is produced in blocks that fit in L1: the source records
+// of the next block are prefetched while the current block is copied,
+// overlapping that block's cache misses instead of taking them one by one.
+
+const int64_t PERMUTE_BLOCK_BYTES = 16384;
+
+inline void prefetchRecord(const char *rec, size_t recSize)
+{
+    for(size_t offset=0; offset<recSize; offset+=64) {
+        __builtin_prefetch(rec + offset);
+    }
+}
+
+// Copy the records ptrs[0..n-1] point to into dst, in that order.
+// recSize is a template parameter when RECSIZE > 0.
+template<int RECSIZE, typename P>
+void permuteRecordsT(const P ptrs[], int64_t n, size_t recSize, char *dst)
+{
+    if(RECSIZE > 0) recSize = RECSIZE;
+    int64_t block = PERMUTE_BLOCK_BYTES / recSize;
+    if(block < 1) block = 1;
+    for(int64_t j=0; j<block && j<n; j++) {
+        prefetchRecord((const char *) ptrs[j], recSize);
+    }
+    for(int64_t blockStart=0; blockStart<n; blockStart+=block) {
+        int64_t blockEnd = blockStart + block < n ? blockStart + block : n;
+        int64_t nextEnd = blockEnd + block < n ? blockEnd + block : n;
+        for(int64_t j=blockEnd; j<nextEnd; j++) {
+            prefetchRecord((const char *) ptrs[j], recSize);
+        }
+        for(int64_t j=blockStart; j<blockEnd; j++) {
+            memcpy(dst + j*recSize, (const char *) ptrs[j], recSize);
+        }
+    }
+}
+
+template<typename P>
+void permuteRecords(const P ptrs[], int64_t n, size_t recSize, char *dst)
+{
+    switch(recSize) {
+#define PERMUTE_RECORDS_CASE(SIZE) \
+        case SIZE: \
+            permuteRecordsT<SIZE>(ptrs, n, recSize, dst); \
+            return;
+        FOR_EACH_FIXED_RECORD_SIZE(PERMUTE_RECORDS_CASE)
+#undef PERMUTE_RECORDS_CASE
+    }
+    permuteRecordsT<0>(ptrs, n, recSize, dst);
+}
+
+#endif /* recordsort_h */
@@ -14,8 +14,34 @@
 #include <time.h>
 #include <string.h>
 #include <string>
+#include <vector>
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <deque>
+#include <map>
+#include <numeric>
+#include <cctype>
 #include "rangen.h"
+#include "sortengines.h"
+#include "parallelsort.h"
+#include "radixsort.h"
+#include "perfcounters.h"
+#include "opcount.h"
+#include "arena.h"
+#include "datasetcache.h"
+#include "externalsort.h"
+#include "infile.h"
+#include "recordsort.h"
+#include "keycompare.h"
+#include "affinity.h"
+#include "stats.h"
+#include "timer.h"
+#include "passtiming.h"
+#include <fcntl.h>
 
 using namespace std;
 
@@ -25,7 +51,29 @@ struct DataRecord {
 
 typedef DataRecord *ArrayElementType;
 
-typedef uint64_t sb_timer_t;
+// The bytes of DataRecord::data that make up the sort key, from -keyoff
+// and -keylen.  Every comparison of records goes through keyGreater().
+static KeySpec sortKey;
+
+// Alternative array layout: each element holds the first 8 bytes of the
+// key, packed big-endian so that integer order is key order, next to the
+// record pointer.  Most comparisons then never touch the DataRecord.
+
+struct KeyPtrElement {
+    uint64_t    key;
+    DataRecord  *rec;
+};
+
+// LAYOUT_RECORDS and LAYOUT_PERMUTE sort the records themselves, which
+// may be of any size from RECORD_SIZE_MIN to RECORD_SIZE_MAX.
+enum TypLayout {LAYOUT_PTR, LAYOUT_KEYPTR, LAYOUT_RECORDS, LAYOUT_PERMUTE, LAYOUT_MAX};
+
+// Distributions of generated keys.
+enum TypDist {DIST_UNIFORM, DIST_SORTED, DIST_REVERSED, DIST_NEARLY_SORTED, DIST_FEW_UNIQUE,
+    DIST_ORGAN_PIPE, DIST_ZIPF, DIST_SORTED_RUNS, DIST_MAX};
+
+// What -tune maximizes: recs/sec, or minimizes: comparisons.
+enum TypTuneScore {TUNE_SCORE_TIME, TUNE_SCORE_COMPARES};
 
 struct TypSettings {
     int64_t arraySizeMin = 1000000;
@@ -34,6 +82,43 @@ struct TypSettings {
     int64_t loopCt = 10;
     int64_t seed = 301;
     string  outputFile = "sortbench.csv";
+    string  algoList = "ShellSort*";
+    vector<TypLayout> layouts = {LAYOUT_PTR};
+    vector<int> recordSizes = {(int) sizeof(DataRecord)};
+    int     nThreads = (int) std::thread::hardware_concurrency();
+    int     radixBits = 10;
+    int     genThreads = (int) std::thread::hardware_concurrency();
+    int     md5Lanes = 0;
+    bool    bPerf = false;
+    bool    bCount = false;
+    string  countFile = "sortbench-counts.csv";
+    bool    bArena = true;
+    TypHugePages hugePages = HUGEPAGES_NONE;
+    bool    bPrefault = true;
+    string  cacheDir;
+    bool    bExternal = false;
+    int64_t extChunk = 1000000;
+    string  extDir = ".";
+    int64_t extBufRecords = 8192;
+    string  inFile;
+    TypInFormat inFormat = INFORMAT_RECORDS;
+    string  sortedFile;
+    TypDist dist = DIST_UNIFORM;
+    int     keyOff = 0;
+    int     keyLen = KEY_LEN_DEFAULT;
+    bool    bPipeline = false;
+    int     nJobs = 1;
+    int     warmup = 0;
+    bool    bStats = false;
+    string  statsFile = "sortbench-stats.csv";
+    double  ciTarget = 0;
+    int     minLoops = 10;
+    TypTimerSource timerSource = TIMER_HAVE_TSC ? TIMER_TSC : TIMER_CLOCK;
+    bool    bTune = false;
+    TypTuneScore tuneScore = TUNE_SCORE_TIME;
+    bool    bPasses = false;
+    string  passFile = "sortbench-passes.csv";
+    int64_t topK = 0;
     bool    bTest = false;
 } Settings;
 
@@ -43,7 +128,18 @@ void usage()
         "sortbench: Program to benchmark sorting algorithms.",
         "Generates arrays of random and sorts them.",
         "Usage: sortbench {-test | [-sizemin:sizemin] [-sizemult:sizemult]",
-        "  [-sizemax:sizemax] [-loopct:loopct] [-seed:seed] [-outfile:outfile] }",
+        "  [-sizemax:sizemax] [-loopct:loopct] [-seed:seed] [-outfile:outfile]",
+        "  [-algo:algo[,algo...]] [-threads:threads] [-layout:layout[,layout]]",
+        "  [-radixbits:radixbits] [-genthreads:genthreads] [-md5lanes:md5lanes]",
+        "  [-perf] [-count] [-countfile:countfile] [-noarena]",
+        "  [-hugepages:hugepages] [-noprefault] [-cachedir:cachedir]",
+        "  [-external] [-extchunk:extchunk] [-extdir:extdir] [-extbuf:extbuf]",
+        "  [-infile:infile] [-informat:informat] [-sortedfile:sortedfile]",
+        "  [-dist:dist] [-recsize:recsize[,recsize...]] [-keyoff:keyoff]",
+        "  [-keylen:keylen] [-pipeline] [-jobs:jobs] [-warmup:warmup]",
+        "  [-stats] [-statsfile:statsfile] [-citarget:citarget] [-minloops:minloops]",
+        "  [-timer:timer] [-tune] [-tunescore:tunescore] [-passes]",
+        "  [-passfile:passfile] [-topk:topk] }",
         "Where:",
         "-test      causes the program to run various self-tests,",
         "           print the results of those tests, and exit.",
@@ -59,6 +155,156 @@ void usage()
         "outfile    is the name of the output CSV file to create; this",
         "           contains the results of each run of the benchmark.",
         "           Default: sortbench.csv",
+        "algo       is a comma-separated list of sort engines to benchmark.",
+        "           Engines are ShellSort followed by a gap sequence name",
+        "           (e.g. ShellSortCiura225Odd), StdSort, StdStableSort,",
+        "           IntroSort, PdqSort, HeapSort, MergeSort and RadixSort.  ParShellSort",
+        "           followed by a gap sequence name is multi-threaded Shellsort.",
+        "           ConstShellSort followed by a gap sequence name is Shellsort with",
+        "           the gaps compiled in as constants, for comparison with ShellSort.",
+        "           BlockedShellSort followed by a gap sequence name inserts 8",
+        "           neighbouring chains in lockstep in large-gap passes, with prefetch.",
+        "           ParMergeSort is merge sort on a work-stealing pool of threads.",
+        "           TopKHeap, TopKPartialSort, TopKSelect and TopKShellSort put",
+        "           just the topk smallest records in order (see topk); without",
+        "           -topk they sort everything.",
+        "           A trailing * matches any suffix, and \"all\" selects every engine.",
+        "           Default: ShellSort*",
+        "threads    is the number of threads used by multi-threaded engines.",
+        "           It is logged after the distribution; other engines log 1.",
+        "           Default: the number of hardware threads.",
+        "layout     is a comma-separated list of array layouts to sort:",
+        "           ptr     is an array of pointers to records.",
+        "           keyptr  is an array of (packed key prefix, pointer) pairs;",
+        "                   results are logged with KeyPtr after the engine name.",
+        "           records moves the records themselves (ShellSort engines only);",
+        "                   logged with Records after the engine name.",
+        "           permute sorts pointers, then copies the records into sorted",
+        "                   order in a second array; logged with Permute.",
+        "           Default: ptr",
+        "radixbits  is the digit width in bits for RadixSort, 5 to 11.  Default: 10",
+        "genthreads is the number of threads used to generate random records.",
+        "           The records are the same for any number of threads.",
+        "           Default: the number of hardware threads.",
+        "md5lanes   is the number of MD5 blocks to hash at once when generating",
+        "           records: 1, 4 (SSE2), 8 (AVX2) or 16 (AVX-512).  The records",
+        "           are the same for any value.  Default: 0, the best the CPU supports.",
+        "-perf      counts cycles, instructions, L1D and LLC read misses, branch",
+        "           misses and dTLB read misses for each sort with Linux perf_event_open,",
+        "           and adds them as extra columns in the output file, after threads.",
+        "-count     runs the sorts in a counting build instead of timing them,",
+        "           counting key comparisons and element moves (copies).",
+        "countfile  is the CSV file -count appends to.  Each sort gives a total",
+        "           line with gap \"total\" and, for ShellSort, a line per gap pass.",
+        "           Default: sortbench-counts.csv",
+        "-noarena   allocates each sort's arrays with new and frees them after.",
+        "           By default, memory for the largest size is mapped once and",
+        "           reused by every sort.",
+        "hugepages  is the kind of pages to back the reused memory with:",
+        "           none, thp (transparent huge pages, via madvise) or hugetlb",
+        "           (MAP_HUGETLB, falling back to thp).  Default: none",
+        "-noprefault leaves the reused memory to be faulted in by the first sort,",
+        "           instead of touching every page before sorting starts.",
+        "cachedir   is a directory in which to keep generated datasets, one file",
+        "           per seed and size.  Later runs map the file and copy the",
+        "           records instead of generating them again.  Default: no cache.",
+        "-external  does an external-memory sort: records are generated extchunk",
+        "           at a time, each chunk is sorted in memory by the engine and",
+        "           written to disk as a run, and the runs are merged with a loser",
+        "           tree.  Results are logged with Ext before the engine name.",
+        "extchunk   is the number of records sorted in memory at once.  Default: 1000000",
+        "extdir     is the directory for the run and output files.  Default: .",
+        "extbuf     is the number of records in each I/O buffer; every run and",
+        "           the output have two.  Default: 8192",
+        "infile     is a file of records to sort instead of random records.  It is",
+        "           memory-mapped and sorted by pointer, without copying.  Each",
+        "           engine sorts the whole file loopct times; sizes are ignored and",
+        "           the seed is logged as 0.",
+        "informat   is the format of infile: records (72-byte records) or lines",
+        "           (newline-delimited).  Keys are as given by keyoff and keylen.",
+        "           Default: records",
+        "sortedfile is a file to which the sorted infile is written with writev,",
+        "           after the first sort.  Default: none",
+        "dist       is the distribution of the generated keys:",
+        "           uniform      independent random keys.",
+        "           sorted       in increasing order.",
+        "           reversed     in decreasing order.",
+        "           nearlysorted sorted, then 1% of the records swapped with",
+        "                        random others.",
+        "           fewunique    only 16 distinct keys.",
+        "           organpipe    increasing for the first half, then decreasing.",
+        "           zipf         keys from a pool of up to 65536, the k'th most",
+        "                        common occurring with probability in proportion to 1/k.",
+        "           sortedruns   sorted runs of sqrt(n) records, then 1% swapped.",
+        "           The records depend only on the seed and size.  The distribution",
+        "           is logged after the ok column.  Not with -external.",
+        "           Default: uniform",
+        "recsize    is a comma-separated list of record sizes in bytes, from 8 to",
+        "           4096.  Sizes other than 72 are logged with the size after the",
+        "           layout name, e.g. ShellSortCiura225OddRecords256.  Default: 72",
+        "keyoff     is the offset of the sort key within each record.  Default: 0",
+        "keylen     is the length of the sort key in bytes.  Keys are compared as",
+        "           unsigned bytes, and must end by byte 71 and within every recsize.",
+        "           Keys other than the default are logged after the layout name,",
+        "           e.g. ShellSortCiura225OddKey24At8.  Default: 6",
+        "-pipeline  generates the records for the next sorts on another thread while",
+        "           a sort is timed, and checks and frees sorted arrays on a third.",
+        "           Both are pinned to a CPU the timed sort does not use.  Only for",
+        "           72-byte records in the ptr and keyptr layouts.",
+        "jobs       is the number of sorts to run at once, each on a worker thread",
+        "           pinned to its own physical core.  The output file is in the",
+        "           same order as for one job.  Multi-threaded engines are confined",
+        "           to their worker's core.  Default: 1",
+        "warmup     is the number of untimed sorts of each size before the timed",
+        "           ones, to settle caches, page mappings and clock speed.  Not with",
+        "           -pipeline, -jobs, -tune, -external or -infile.  Default: 0",
+        "-stats     summarizes the runs of each engine and size, in recs/sec: the",
+        "           median and MAD (scaled to estimate a standard deviation) after",
+        "           rejecting runs more than 3.5 MADs from the median, the 10%",
+        "           trimmed mean, and a 95% bootstrap confidence interval for the",
+        "           median.  Summaries are printed and appended to statsfile as",
+        "           name,nrecs,dist,threads,runs,rejected,median,mad,trimmedmean,",
+        "           cilow,cihigh.",
+        "statsfile  is the CSV file -stats appends to.  Default: sortbench-stats.csv",
+        "citarget   stops repeating a size once the confidence interval is at most",
+        "           this fraction of the median, e.g. 0.01, after at least minloops",
+        "           runs.  loopct is then the most runs per size.  Implies -stats.",
+        "           Not with -pipeline, -jobs, -tune, -external or -infile.",
+        "           Default: 0, always run loopct times.",
+        "minloops   is the fewest runs per size with citarget.  Default: 10",
+        "timer      is how sorts are timed: clock (the monotonic system clock) or",
+        "           tsc (the CPU's time-stamp counter, calibrated against the clock",
+        "           at startup; the clock is used if the counter is not invariant).",
+        "           The cost of reading the timer is subtracted.",
+        "           Default: tsc on x86, else clock",
+        "-tune      searches for the ShellSort gap sequence that sorts sizemax",
+        "           records fastest.  Candidates start with Ciura's gaps, then",
+        "           multiply each gap by a searched multiplier, making it odd,",
+        "           coprime to the gap before, or neither.  Each candidate is",
+        "           sorted loopct/2 times in the first layout and record size;",
+        "           candidates are sorted concurrently on jobs workers pinned to",
+        "           physical cores (default: all of them), and logged to outfile",
+        "           as ShellSortTuned followed by the multiplier and rule.  The",
+        "           winner is printed as an entry for the allGaps table.",
+        "tunescore  is what -tune optimizes: time (median recs/sec) or compares",
+        "           (comparisons, counted on one thread).  Default: time",
+        "-passes    also times each gap pass of the ShellSort engines, in the ptr",
+        "           and keyptr layouts.  With -perf, the counters are read for each",
+        "           pass instead of for the whole sort.  As timing the passes adds",
+        "           to the time of the whole sort, those sorts are logged with",
+        "           Passes after the name, e.g. ShellSortLee21Passes.  Not with",
+        "           pipeline, jobs, tune, external or infile.",
+        "passfile   is the CSV file -passes appends to, with a line per pass:",
+        "           name,nrecs,seed,gap,ns,ok, then any counters.",
+        "           Default: sortbench-passes.csv",
+        "topk       asks only for the topk smallest records, in order, at the",
+        "           start of the array.  The TopK engines do just that: with a",
+        "           bounded heap, std::partial_sort, quickselect then sorting the",
+        "           first topk, or Shellsort on a buffer of candidates.  Other",
+        "           engines sort everything, for comparison.  Each sort is checked",
+        "           for the topk smallest in order, and logged with Top and topk",
+        "           after the name, e.g. TopKHeapTop100.  Not with -external or",
+        "           the permute layout.  Default: 0, sort everything.",
         "MRR  2023-05-03",
         NULL
     };
@@ -95,6 +341,52 @@ bool parseArg(const char *arg, string &name, string &val)
     return bOK;
 }
 
+const char *nameOfLayout(TypLayout layout)
+{
+    const char *names[LAYOUT_MAX] = {"ptr", "keyptr", "records", "permute"};
+    return layout < LAYOUT_MAX ? names[layout] : "unknown";
+}
+
+// Parse a comma-separated list of layout names.
+bool parseLayouts(const string &val, vector<TypLayout> &layouts)
+{
+    bool bOK=true;
+    layouts.clear();
+    size_t start = 0;
+    for(;;) {
+        size_t comma = val.find(',', start);
+        string item = val.substr(start, string::npos==comma ? string::npos : comma-start);
+        int ilayout;
+        for(ilayout=0; ilayout<LAYOUT_MAX && item != nameOfLayout((TypLayout) ilayout); ilayout++);
+        if(ilayout < LAYOUT_MAX) {
+            layouts.push_back((TypLayout) ilayout);
+        } else {
+            bOK = false;
+        }
+        if(string::npos == comma) break;
+        start = comma + 1;
+    }
+    return bOK && !layouts.empty();
+}
+
+const char *nameOfDist(TypDist dist)
+{
+    const char *names[DIST_MAX] = {"uniform", "sorted", "reversed", "nearlysorted", "fewunique",
+        "organpipe", "zipf", "sortedruns"};
+    return dist < DIST_MAX ? names[dist] : "unknown";
+}
+
+bool parseDist(const string &val, TypDist &dist)
+{
+    for(int j=0; j<DIST_MAX; j++) {
+        if(val == nameOfDist((TypDist) j)) {
+            dist = (TypDist) j;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool parseCmdLine(int argc, const char * argv[], TypSettings &settings)
 {
     bool bOK=true;
@@ -117,6 +409,157 @@ bool parseCmdLine(int argc, const char * argv[], TypSettings &settings)
                 settings.seed = atol(val.c_str());
             } else if("outfile"==name) {
                 settings.outputFile = val;
+            } else if("algo"==name) {
+                settings.algoList = val;
+            } else if("layout"==name) {
+                if(!parseLayouts(val, settings.layouts)) {
+                    printf("Invalid layout list: %s\n", val.c_str());
+                    bOK = false;
+                }
+            } else if("radixbits"==name) {
+                settings.radixBits = atoi(val.c_str());
+                if(settings.radixBits < RADIX_MIN_DIGIT_BITS || settings.radixBits > RADIX_MAX_DIGIT_BITS) {
+                    printf("radixbits must be from %d to %d\n", RADIX_MIN_DIGIT_BITS, RADIX_MAX_DIGIT_BITS);
+                    bOK = false;
+                }
+            } else if("genthreads"==name) {
+                settings.genThreads = atoi(val.c_str());
+                if(settings.genThreads < 1) {
+                    printf("genthreads must be at least 1\n");
+                    bOK = false;
+                }
+            } else if("count"==name) {
+                settings.bCount = true;
+            } else if("countfile"==name) {
+                settings.countFile = val;
+            } else if("noarena"==name) {
+                settings.bArena = false;
+            } else if("hugepages"==name) {
+                if("none"==val) {
+                    settings.hugePages = HUGEPAGES_NONE;
+                } else if("thp"==val) {
+                    settings.hugePages = HUGEPAGES_THP;
+                } else if("hugetlb"==val) {
+                    settings.hugePages = HUGEPAGES_HUGETLB;
+                } else {
+                    printf("hugepages must be none, thp or hugetlb\n");
+                    bOK = false;
+                }
+            } else if("noprefault"==name) {
+                settings.bPrefault = false;
+            } else if("cachedir"==name) {
+                settings.cacheDir = val;
+            } else if("external"==name) {
+                settings.bExternal = true;
+            } else if("extchunk"==name) {
+                settings.extChunk = atol(val.c_str());
+                if(settings.extChunk < 1) {
+                    printf("extchunk must be at least 1\n");
+                    bOK = false;
+                }
+            } else if("extdir"==name) {
+                settings.extDir = val;
+            } else if("extbuf"==name) {
+                settings.extBufRecords = atol(val.c_str());
+                if(settings.extBufRecords < 1) {
+                    printf("extbuf must be at least 1\n");
+                    bOK = false;
+                }
+            } else if("infile"==name) {
+                settings.inFile = val;
+            } else if("informat"==name) {
+                if("records"==val) {
+                    settings.inFormat = INFORMAT_RECORDS;
+                } else if("lines"==val) {
+                    settings.inFormat = INFORMAT_LINES;
+                } else {
+                    printf("informat must be records or lines\n");
+                    bOK = false;
+                }
+            } else if("sortedfile"==name) {
+                settings.sortedFile = val;
+            } else if("dist"==name) {
+                if(!parseDist(val, settings.dist)) {
+                    printf("Invalid distribution: %s\n", val.c_str());
+                    bOK = false;
+                }
+            } else if("recsize"==name) {
+                settings.recordSizes.clear();
+                size_t start = 0;
+                for(;;) {
+                    size_t comma = val.find(',', start);
+                    int recSize = atoi(val.substr(start, string::npos==comma ? string::npos : comma-start).c_str());
+                    if(recSize < RECORD_SIZE_MIN || recSize > RECORD_SIZE_MAX) {
+                        printf("recsize must be from %d to %d\n", RECORD_SIZE_MIN, RECORD_SIZE_MAX);
+                        bOK = false;
+                    }
+                    settings.recordSizes.push_back(recSize);
+                    if(string::npos == comma) break;
+                    start = comma + 1;
+                }
+            } else if("keyoff"==name) {
+                settings.keyOff = atoi(val.c_str());
+            } else if("keylen"==name) {
+                settings.keyLen = atoi(val.c_str());
+            } else if("jobs"==name) {
+                settings.nJobs = atoi(val.c_str());
+                if(settings.nJobs < 1) {
+                    printf("jobs must be at least 1\n");
+                    bOK = false;
+                }
+            } else if("warmup"==name) {
+                settings.warmup = atoi(val.c_str());
+            } else if("stats"==name) {
+                settings.bStats = true;
+            } else if("statsfile"==name) {
+                settings.statsFile = val;
+            } else if("citarget"==name) {
+                settings.ciTarget = atof(val.c_str());
+                settings.bStats = true;
+            } else if("minloops"==name) {
+                settings.minLoops = atoi(val.c_str());
+            } else if("timer"==name) {
+                if("clock"==val) {
+                    settings.timerSource = TIMER_CLOCK;
+                } else if("tsc"==val) {
+                    settings.timerSource = TIMER_TSC;
+                } else {
+                    printf("timer must be clock or tsc\n");
+                    bOK = false;
+                }
+            } else if("topk"==name) {
+                settings.topK = atoll(val.c_str());
+                if(settings.topK < 1) {
+                    printf("topk must be at least 1\n");
+                    bOK = false;
+                }
+            } else if("passes"==name) {
+                settings.bPasses = true;
+            } else if("passfile"==name) {
+                settings.passFile = val;
+            } else if("tune"==name) {
+                settings.bTune = true;
+            } else if("tunescore"==name) {
+                if("time"==val) {
+                    settings.tuneScore = TUNE_SCORE_TIME;
+                } else if("compares"==val) {
+                    settings.tuneScore = TUNE_SCORE_COMPARES;
+                } else {
+                    printf("tunescore must be time or compares\n");
+                    bOK = false;
+                }
+            } else if("pipeline"==name) {
+                settings.bPipeline = true;
+            } else if("perf"==name) {
+                settings.bPerf = true;
+            } else if("md5lanes"==name) {
+                settings.md5Lanes = atoi(val.c_str());
+            } else if("threads"==name) {
+                settings.nThreads = atoi(val.c_str());
+                if(settings.nThreads < 1) {
+                    printf("threads must be at least 1\n");
+                    bOK = false;
+                }
             } else {
                 printf("Unrecognized argument: %s\n", name.c_str());
                 bOK = false;
@@ -127,12 +570,82 @@ bool parseCmdLine(int argc, const char * argv[], TypSettings &settings)
         }
     }
 
+    if(settings.keyOff < 0 || settings.keyLen < 1 || settings.keyOff + settings.keyLen > KEY_END_MAX) {
+        printf("keyoff must be at least 0 and keylen at least 1, with keyoff+keylen at most %d\n", KEY_END_MAX);
+        bOK = false;
+    }
+    if(settings.bPipeline && settings.nJobs > 1) {
+        printf("pipeline and jobs cannot be used together\n");
+        bOK = false;
+    }
+    if(settings.warmup < 0 || settings.ciTarget < 0 || settings.minLoops < 2) {
+        printf("warmup and citarget must be at least 0, and minloops at least 2\n");
+        bOK = false;
+    }
+    // Only doSorts does warmup sorts and stops early at citarget.
+    if((settings.warmup > 0 || settings.ciTarget > 0) && (settings.bPipeline || settings.nJobs > 1 ||
+       settings.bTune || settings.bExternal || !settings.inFile.empty())) {
+        printf("warmup and citarget cannot be used with pipeline, jobs, tune, external or infile\n");
+        bOK = false;
+    }
+    if(settings.topK > 0 && (settings.bExternal ||
+       std::find(settings.layouts.begin(), settings.layouts.end(), LAYOUT_PERMUTE) != settings.layouts.end())) {
+        printf("topk cannot be used with external or the permute layout\n");
+        bOK = false;
+    }
+    // The external sort generates its records a chunk at a time, so only
+    // uniform keys are the same over all the records as within a chunk.
+    if(settings.bExternal && DIST_UNIFORM != settings.dist) {
+        printf("dist cannot be used with external\n");
+        bOK = false;
+    }
+    // passTimes belongs to the thread of doSorts, which alone clears it.
+    if(settings.bPasses && (settings.bPipeline || settings.nJobs > 1 || settings.bTune || settings.bExternal ||
+                            !settings.inFile.empty())) {
+        printf("passes cannot be used with pipeline, jobs, tune, external or infile\n");
+        bOK = false;
+    }
+    for(int recSize : settings.recordSizes) {
+        if(settings.keyOff + settings.keyLen > recSize) {
+            printf("The key does not fit in records of %d bytes\n", recSize);
+            bOK = false;
+        }
+        if(settings.bPipeline && recSize != sizeof(DataRecord)) {
+            printf("pipeline supports only %d-byte records\n", (int) sizeof(DataRecord));
+            bOK = false;
+        }
+    }
+    for(TypLayout layout : settings.layouts) {
+        if(settings.bPipeline && layout != LAYOUT_PTR && layout != LAYOUT_KEYPTR) {
+            printf("pipeline supports only the ptr and keyptr layouts\n");
+            bOK = false;
+        }
+    }
+
     return bOK;
 }
 
-bool elementGreaterThan(ArrayElementType &first, ArrayElementType &second)
+bool elementGreaterThan(const ArrayElementType &first, const ArrayElementType &second)
+{
+    return keyGreater(sortKey, first->data, second->data);
+}
+
+// Returns the first 8 bytes of a record's key as a big-endian integer.
+inline uint64_t keyPrefix(const DataRecord *rec)
+{
+    return keyPrefixWord(sortKey, rec->data);
+}
+
+inline bool keyPtrGreaterThan(const KeyPtrElement &first, const KeyPtrElement &second)
 {
-    return (strncmp(first->data, second->data, 6) > 0);
+    if(first.key != second.key) {
+        return first.key > second.key;
+    }
+    // Only keys longer than the prefix need to look at the records.
+    if(sortKey.len > KEY_WORD_LEN) {
+        return elementGreaterThan(first.rec, second.rec);
+    }
+    return false;
 }
 
 FILE *fileLog = NULL;
@@ -146,13 +659,82 @@ void closeLogFile()
     fclose(fileLog);
 }
 
-void writeLogRec(const char *sortName, int64_t nRecs, int64_t seed, int64_t elapsedNs, bool bSortedOK)
+//=====  Run statistics  ==============================================
+// With -stats, writeLogRec also collects the rate of each run.  The runs
+// of one engine and size are logged together, so the summary of a cell
+// is written when the next cell's first run arrives, or at the end.
+
+FILE *fileStats = NULL;
+struct TypStatsCell {
+    string  sortName;
+    int64_t nRecs = 0;
+    string  distName;
+    int     nThreads = 1;
+    vector<double> recsPerSec;
+} statsCell;
+
+void printStats(const char *sortName, int64_t nRecs, const TypStats &stats)
+{
+    printf("%s size %lld: %lld runs, %lld rejected; median %.1f recs/sec, MAD %.1f, trimmed mean %.1f, "
+           "%.0f%% CI %.1f to %.1f\n", sortName, nRecs, stats.nRuns, stats.nRejected, stats.median, stats.mad,
+           stats.trimmedMean, 100*STATS_CONFIDENCE, stats.ciLow, stats.ciHigh);
+}
+
+void flushStats()
+{
+    if(statsCell.recsPerSec.empty()) return;
+    TypStats stats;
+    statsCompute(statsCell.recsPerSec, stats);
+    fprintf(fileStats, "%s,%lld,%s,%d,%lld,%lld,%f,%f,%f,%f,%f\n", statsCell.sortName.c_str(), statsCell.nRecs,
+            statsCell.distName.c_str(), statsCell.nThreads, stats.nRuns, stats.nRejected, stats.median, stats.mad,
+            stats.trimmedMean, stats.ciLow, stats.ciHigh);
+    printStats(statsCell.sortName.c_str(), statsCell.nRecs, stats);
+    statsCell.recsPerSec.clear();
+}
+
+void statsAddRun(const char *sortName, int64_t nRecs, const char *distName, int nThreads, double recsPerSec)
+{
+    if(statsCell.sortName != sortName || statsCell.nRecs != nRecs || statsCell.distName != distName ||
+       statsCell.nThreads != nThreads) {
+        flushStats();
+        statsCell.sortName = sortName;
+        statsCell.nRecs = nRecs;
+        statsCell.distName = distName;
+        statsCell.nThreads = nThreads;
+    }
+    statsCell.recsPerSec.push_back(recsPerSec);
+}
+
+void openStatsFile(const char *fileName)
+{
+    fileStats = fopen(fileName, "a");
+}
+
+void closeStatsFile()
+{
+    flushStats();
+    fclose(fileStats);
+    fileStats = NULL;
+}
+
+// pPerf, if not NULL, holds hardware counter values to append to the record.
+// distName is the input distribution, or where the records came from.
+// nThreads is the number of threads the engine sorted with.
+void writeLogRec(const char *sortName, int64_t nRecs, int64_t seed, int64_t elapsedNs, bool bSortedOK,
+                 const char *distName, int nThreads, const TypPerfCounts *pPerf = NULL)
 {
     double elapsedSecs = 0.000000001 * elapsedNs;
     double recsPerSec = nRecs / elapsedSecs;
     fprintf(fileLog,
-            "%s,%lld,%lld,%lld,%f,%s\n",sortName, nRecs, seed, elapsedNs, recsPerSec,
-            bSortedOK ? "true":"false");
+            "%s,%lld,%lld,%lld,%f,%s,%s,%d",sortName, nRecs, seed, elapsedNs, recsPerSec,
+            bSortedOK ? "true":"false", distName, nThreads);
+    if(NULL != pPerf) {
+        perfWriteCSV(fileLog, pPerf);
+    }
+    fprintf(fileLog, "\n");
+    if(NULL != fileStats) {
+        statsAddRun(sortName, nRecs, distName, nThreads, recsPerSec);
+    }
 }
 
 enum TypGap {GAP_CIURA_22, GAP_CIURA_225, GAP_CIURA_225_ODD, GAP_CIURA_235, GAP_JDAW1, GAP_KNUTH73, GAP_LEE21,
@@ -176,6 +758,49 @@ int64_t allGaps[GAP_MAX][NUM_GAPS] = {
     {0}
 };
 
+// The same sequences as constexpr arrays, for shellSortFixedT.  testConstGaps
+// checks that they match allGaps as computed by buildGaps.
+constexpr std::array<int64_t, 35> CONST_GAPS_CIURA_22 = {
+    1, 4, 10, 23, 57, 132, 301, 701, 1542, 3392, 7462, 16416, 36115, 79453, 174796, 384551, 846012,
+    1861226, 4094697, 9008333, 19818332, 43600330, 95920726, 211025597, 464256313, 1021363888,
+    2247000553, 4943401216, 10875482675, 23926061885, 52637336147, 115802139523, 254764706950,
+    560482355290, 1233061181638};
+constexpr std::array<int64_t, 35> CONST_GAPS_CIURA_225 = {
+    1, 4, 10, 23, 57, 132, 301, 701, 1577, 3548, 7983, 17961, 40412, 90927, 204585, 460316, 1035711,
+    2330349, 5243285, 11797391, 26544129, 59724290, 134379652, 302354217, 680296988, 1530668223,
+    3444003501, 7749007877, 17435267723, 39229352376, 88266042846, 198598596403, 446846841906,
+    1005405394288, 2262162137148};
+constexpr std::array<int64_t, 35> CONST_GAPS_CIURA_225_ODD = {
+    1, 4, 10, 23, 57, 132, 301, 701, 1577, 3549, 7985, 17967, 40425, 90957, 204653, 460469, 1036055,
+    2331123, 5245027, 11801311, 26552949, 59744135, 134424303, 302454681, 680523033, 1531176825,
+    3445147857, 7751582679, 17441061027, 39242387311, 88295371449, 198664585761, 446995317963,
+    1005739465417, 2262913797189};
+constexpr std::array<int64_t, 35> CONST_GAPS_CIURA_235 = {
+    1, 4, 10, 23, 57, 132, 301, 701, 1647, 3870, 9094, 21370, 50219, 118014, 277332, 651730,
+    1531565, 3599177, 8458065, 19876452, 46709662, 109767705, 257954106, 606192149, 1424551550,
+    3347696142, 7867085933, 18487651942, 43445982063, 102098057848, 239930435942, 563836524463,
+    1325015832488, 3113787206346, 7317399934913};
+constexpr std::array<int64_t, 35> CONST_GAPS_JDAW1 = {
+    1, 3, 7, 16, 37, 83, 187, 419, 937, 2099, 4693, 10499, 23479, 52501, 117391, 262495, 586961,
+    1312481, 2934793, 6562397, 14673961, 32811973, 73369801, 164059859, 366848983, 820299269,
+    1834244921, 4101496331, 9171224603, 20507481647, 45856123009, 102537408229, 229280615033,
+    512687041133, 1146403075157};
+constexpr std::array<int64_t, 35> CONST_GAPS_KNUTH73 = {
+    1, 4, 13, 40, 121, 364, 1093, 3280, 9841, 29524, 88573, 265720, 797161, 2391484, 7174453,
+    21523360, 64570081, 193710244, 581130733, 1073741823, 1073741823, 1073741823, 1073741823,
+    1073741823, 1073741823, 1073741823, 1073741823, 1073741823, 1073741823, 1073741823, 1073741823,
+    1073741823, 1073741823, 1073741823, 1073741823};
+constexpr std::array<int64_t, 35> CONST_GAPS_LEE21 = {
+    1, 4, 9, 20, 45, 102, 230, 516, 1158, 2599, 5831, 13082, 29351, 65853, 147748, 331490, 743735,
+    1668650, 3743800, 8399623, 18845471, 42281871, 94863989, 212837706, 477524607, 1071378536,
+    2403754591, 5393085583, 12099975682, 27147615084, 60908635199, 136655165852, 306600768395,
+    687892262211, 1543361312777};
+constexpr std::array<int64_t, 35> CONST_GAPS_TOKUDA92 = {
+    1, 4, 9, 20, 46, 103, 233, 525, 1182, 2660, 5985, 13467, 30301, 68178, 153401, 345152, 776591,
+    1747331, 3931496, 8845866, 19903198, 44782196, 100759940, 226709866, 510097200, 1147718700,
+    2582367076, 5810325920, 13073233321, 29414774973, 66183243690, 148912298303, 335052671183,
+    753868510162, 1696204147864};
+
 const char *nameOfGapType(TypGap gapType)
 {
     const char *name = "Unknown";
@@ -309,25 +934,24 @@ void printGaps()
     }
 }
 
-sb_timer_t getCurrentNanoseconds()
-{
-    // http://www.manpagez.com/man/3/clock_gettime_nsec_np/
-    sb_timer_t nano = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
-    return nano;
-}
-
 //=====  Pseudo-random number generation  ==============================
 #define USING_MD5_PRNG 1
 
+// The generator state is per thread, so that -jobs workers and the
+// -pipeline producer each generate their own records independently.
 #ifdef USING_MRR_PRNG
-static uint64_t randoms[4];
+static thread_local uint64_t randoms[4];
 #elif USING_MD5_PRNG
-static myRandomContext randomContext;
+static thread_local myRandomContext randomContext;
+// The seed last given to setRandomSeed, for the dataset cache.
+static thread_local uint64_t randomSeed;
 #endif
 
+// The characters that random records are made of.
+const char *possibleChars = "abcdefghijklmnopqrstuvwxyz012345";
+
 char getRandomChar()
 {
-    static const char *possibleChars = "abcdefghijklmnopqrstuvwxyz012345";
 #ifdef USING_MRR_PRNG
     uint64_t randres = (((randoms[0]>>3) + randoms[2]) ^ 0x2d135) + (randoms[1]>>7);
     randoms[0] = 37493*randoms[1];
@@ -357,23 +981,237 @@ void setRandomSeed(uint64_t seed)
     randoms[3] = (seed << 9) ^ 0x59031c3;
 #elif USING_MD5_PRNG
     mySetRandomSeed(&randomContext, seed);
+    randomSeed = seed;
 #endif
 }
 
-ArrayElementType * createArray(int64_t nElements, DataRecord *&arrayData)
+// Number of threads createArray may use to generate records.
+static int randomThreads = 1;
+// Don't bother starting a thread for fewer records than this.
+const int64_t MIN_RECORDS_PER_GEN_THREAD = 16384;
+
+void setRandomThreads(int nThreads)
 {
-    arrayData = new DataRecord[nElements];
-    ArrayElementType *arrayPointers = new ArrayElementType[nElements];
+    randomThreads = nThreads < 1 ? 1 : nThreads;
+}
+
+// Directory of the dataset cache, or empty if datasets are not cached.
+static string datasetCacheDir;
+// Describes the generator in dataset files.  Change it whenever the
+// records generated for a seed change.
+const char *DATASET_GENERATOR = "md5 32 chars";
+
+void setDatasetCache(const string &cacheDir)
+{
+    datasetCacheDir = cacheDir;
+}
+
+#if USING_MD5_PRNG
+// Fill records first..last-1 with random characters.  ctx is a private
+// copy of the random context; startPos is the stream position of the
+// first character of record 0.  The characters are exactly those that
+// getRandomChar() would return.
+void fillRandomRecords(DataRecord *arrayData, int64_t first, int64_t last,
+                       myRandomContext ctx, uint64_t startPos)
+{
+    const int nChars = sizeof(arrayData[0].data) - 1;
+    // Generate a batch of records' bytes at a time, so that myRandomBytes
+    // can hash many blocks per call.
+    const int64_t BATCH_RECORDS = 64;
+    unsigned char bytes[BATCH_RECORDS*nChars];
+    mySeekRandom(&ctx, startPos + first*nChars);
+    for(int64_t batchStart=first; batchStart<last; batchStart+=BATCH_RECORDS) {
+        int64_t batchEnd = batchStart + BATCH_RECORDS;
+        if(batchEnd > last) batchEnd = last;
+        myRandomBytes(&ctx, bytes, (batchEnd-batchStart)*nChars);
+        const unsigned char *pByte = bytes;
+        for(int64_t j=batchStart; j<batchEnd; j++) {
+            char *data = arrayData[j].data;
+            for(int ichar=0; ichar<nChars; ichar++) {
+                data[ichar] = possibleChars[*pByte++ & 0x1f];
+            }
+            data[nChars] = '\0';
+        }
+    }
+}
+
+// Generate records 0..nElements-1 from stream position startPos.
+// Since the random stream is seekable, the records can be split among
+// threads, each generating its share directly from the right position.
+void generateRecords(DataRecord *arrayData, int64_t nElements, uint64_t startPos)
+{
+    int64_t nThreads = nElements / MIN_RECORDS_PER_GEN_THREAD;
+    if(nThreads > randomThreads) nThreads = randomThreads;
+    if(nThreads <= 1) {
+        fillRandomRecords(arrayData, 0, nElements, randomContext, startPos);
+    } else {
+        vector<std::thread> threads;
+        for(int64_t ithread=0; ithread<nThreads; ithread++) {
+            threads.emplace_back(fillRandomRecords, arrayData, ithread*nElements/nThreads,
+                                 (ithread+1)*nElements/nThreads, randomContext, startPos);
+        }
+        for(std::thread &thr : threads) {
+            thr.join();
+        }
+    }
+}
+#endif
+
+//=====  Input distributions  =========================================
+// Each distribution starts from uniform random records and rearranges
+// them or rewrites their keys.  Any further randomness is drawn from the
+// same stream, after the records, so the result still depends only on
+// the seed and size.
+
+static TypDist inputDist = DIST_UNIFORM;
+
+void setInputDist(TypDist dist)
+{
+    inputDist = dist;
+}
+
+// Returns a random number from 0 to limit-1.
+uint64_t randomBelow(uint64_t limit)
+{
+    uint64_t r = 0;
+#if USING_MD5_PRNG
+    myRandomBytes(&randomContext, (unsigned char *) &r, sizeof(r));
+#else
+    for(int j=0; j<13; j++) {
+        r = (r << 5) | (strchr(possibleChars, getRandomChar()) - possibleChars);
+    }
+#endif
+    return r % limit;
+}
+
+bool recordLess(const DataRecord &first, const DataRecord &second)
+{
+    return keyGreater(sortKey, second.data, first.data);
+}
+
+bool recordGreater(const DataRecord &first, const DataRecord &second)
+{
+    return keyGreater(sortKey, first.data, second.data);
+}
+
+// Swap 1% of the records, at least one, with records at random positions.
+void swapRandomRecords(DataRecord *arrayData, int64_t n)
+{
+    int64_t nSwaps = n/100 > 0 ? n/100 : 1;
+    for(int64_t j=0; j<nSwaps; j++) {
+        std::swap(arrayData[randomBelow(n)], arrayData[randomBelow(n)]);
+    }
+}
+
+// Give every record one of the keys of the first poolSize records.
+// weights[k] is the cumulative weight of keys 0..k, or NULL for equal weights.
+void assignPoolKeys(DataRecord *arrayData, int64_t n, int64_t poolSize, const double *weights)
+{
+    vector<DataRecord> pool(arrayData, arrayData+poolSize);
+    const uint64_t RANDOM_SCALE = (uint64_t)1 << 53;
+    for(int64_t j=0; j<n; j++) {
+        int64_t k;
+        if(NULL == weights) {
+            k = randomBelow(poolSize);
+        } else {
+            double target = weights[poolSize-1] * randomBelow(RANDOM_SCALE) / RANDOM_SCALE;
+            k = std::upper_bound(weights, weights+poolSize, target) - weights;
+            if(k >= poolSize) k = poolSize-1;
+        }
+        memcpy(arrayData[j].data + sortKey.off, pool[k].data + sortKey.off, sortKey.len);
+    }
+}
+
+// Rearrange or rewrite uniform random records to follow inputDist.
+void applyDist(DataRecord *arrayData, int64_t n)
+{
+    const int64_t FEW_UNIQUE_KEYS = 16;
+    const int64_t ZIPF_POOL_MAX = 65536;
+    if(n <= 1) return;
+    switch(inputDist) {
+        case DIST_UNIFORM:
+        case DIST_MAX:
+            break;
+        case DIST_SORTED:
+            std::sort(arrayData, arrayData+n, recordLess);
+            break;
+        case DIST_REVERSED:
+            std::sort(arrayData, arrayData+n, recordGreater);
+            break;
+        case DIST_NEARLY_SORTED:
+            std::sort(arrayData, arrayData+n, recordLess);
+            swapRandomRecords(arrayData, n);
+            break;
+        case DIST_FEW_UNIQUE:
+            assignPoolKeys(arrayData, n, std::min(n, FEW_UNIQUE_KEYS), NULL);
+            break;
+        case DIST_ORGAN_PIPE:
+            std::sort(arrayData, arrayData+n/2, recordLess);
+            std::sort(arrayData+n/2, arrayData+n, recordGreater);
+            break;
+        case DIST_ZIPF: {
+            int64_t poolSize = std::min(n, ZIPF_POOL_MAX);
+            vector<double> weights(poolSize);
+            double sum = 0.0;
+            for(int64_t k=0; k<poolSize; k++) {
+                sum += 1.0 / (k+1);
+                weights[k] = sum;
+            }
+            assignPoolKeys(arrayData, n, poolSize, weights.data());
+            break;
+        }
+        case DIST_SORTED_RUNS: {
+            int64_t runLen = (int64_t) sqrt((double) n);
+            for(int64_t start=0; start<n; start+=runLen) {
+                std::sort(arrayData+start, arrayData+std::min(n, start+runLen), recordLess);
+            }
+            swapRandomRecords(arrayData, n);
+            break;
+        }
+    }
+}
+
+// Fill arrayData with random records and point arrayPointers at them.
+// The keys follow the distribution set by setInputDist.
+// Both arrays must have room for nElements.
+void fillArray(int64_t nElements, DataRecord *arrayData, ArrayElementType *arrayPointers)
+{
+    for(int64_t j=0; j<nElements; j++) {
+        arrayPointers[j] = &arrayData[j];
+    }
+#if USING_MD5_PRNG
+    uint64_t startPos = myRandomPosition(&randomContext);
+    // Only arrays generated right after setRandomSeed are cached, so that
+    // the seed and size identify the records.
+    bool bCacheable = !datasetCacheDir.empty() && 0 == startPos;
+    if(!bCacheable || !datasetLoad(datasetCacheDir.c_str(), DATASET_GENERATOR, randomSeed,
+                                   nElements, sizeof(DataRecord), arrayData)) {
+        generateRecords(arrayData, nElements, startPos);
+        if(bCacheable && !datasetSave(datasetCacheDir.c_str(), DATASET_GENERATOR, randomSeed,
+                                      nElements, sizeof(DataRecord), arrayData)) {
+            // Not fatal: the records are simply generated again next time.
+            printf("Cannot write %s\n", datasetFileName(datasetCacheDir.c_str(), randomSeed, nElements).c_str());
+        }
+    }
+    mySeekRandom(&randomContext, startPos + nElements*(sizeof(arrayData[0].data)-1));
+#else
     for(int64_t j=0; j<nElements; j++) {
         DataRecord *pRec = &arrayData[j];
-        arrayPointers[j] = pRec;
         int ichar;
         for(ichar=0; ichar<sizeof(pRec->data)-1; ichar++) {
             pRec->data[ichar] = getRandomChar();
         }
         pRec->data[ichar] = '\0';
     }
-    
+#endif
+    applyDist(arrayData, nElements);
+}
+
+ArrayElementType * createArray(int64_t nElements, DataRecord *&arrayData)
+{
+    arrayData = new DataRecord[nElements];
+    ArrayElementType *arrayPointers = new ArrayElementType[nElements];
+    fillArray(nElements, arrayData, arrayPointers);
     return arrayPointers;
 }
 
@@ -426,98 +1264,1759 @@ bool checkArrayOrder(ArrayElementType * pArray, int64_t n)
     return bOK;
 }
 
-bool doOneSort(int64_t n, int64_t gaps[], sb_timer_t &elapsedNs)
+// Returns true if the first k elements are the k smallest, in order:
+// pArray[0..k-1] is in order and nothing after is less than pArray[k-1].
+// k of 0, or of at least n, checks the whole array.
+bool checkTopKOrder(ArrayElementType * pArray, int64_t n, int64_t k)
 {
-    bool bOK=true;
-    DataRecord *arrayData;
-    ArrayElementType * pArray = createArray(n, arrayData);
-    sb_timer_t start = getCurrentNanoseconds();
-    shellSort(pArray, n, gaps);
-    elapsedNs = getCurrentNanoseconds() - start;
-    bOK = checkArrayOrder(pArray, n);
-    delete []arrayData;
-    delete []pArray;
+    if(k <= 0 || k >= n) return checkArrayOrder(pArray, n);
+    bool bOK = checkArrayOrder(pArray, k);
+    for(int64_t j=k; bOK && j<n; j++) {
+        if(elementGreaterThan(pArray[k-1], pArray[j])) {
+            bOK = false;
+        }
+    }
     return bOK;
 }
 
-void doSorts(TypSettings settings)
+//=====  Sort engines  ================================================
+// Every sort that can be benchmarked is registered in allEngines with the
+// name it is logged under and a function with a common signature.
+
+struct TypSortParams {
+    int64_t *gaps = NULL;   // Shellsort gap sequence; ignored by other engines.
+    int     nThreads = 1;   // Number of threads for multi-threaded engines.
+    int     radixBits = 10; // Digit width for RadixSort.
+    bool    bTimePasses = false;    // Record each gap pass in passTimes (ShellSort only).
+    int64_t topK = 0;       // Smallest elements to put in order; 0 for all.
+};
+
+typedef void (*TypSortFunc)(ArrayElementType a[], int64_t n, const TypSortParams &params);
+typedef void (*TypKeyPtrSortFunc)(KeyPtrElement a[], int64_t n, const TypSortParams &params);
+
+// Sorts n records of recSize bytes, moving the records.
+typedef void (*TypRecordSortFunc)(char *records, int64_t n, size_t recSize, const TypSortParams &params);
+
+// Elements for the operation-counting instantiations of the engines.
+typedef Counted<ArrayElementType> CountedElement;
+typedef void (*TypCountedSortFunc)(CountedElement a[], int64_t n, const TypSortParams &params);
+
+struct TypSortEngine {
+    string              name;
+    TypSortFunc         func;
+    TypKeyPtrSortFunc   funcKeyPtr;     // NULL if the engine has no KeyPtr version.
+    TypCountedSortFunc  funcCounted;    // Same sort, counting comparisons and moves.
+    TypRecordSortFunc   funcRecords;    // NULL if the engine can't sort records in place.
+    TypSortParams       params;
+};
+
+std::atomic<int64_t> opCompares(0);
+std::atomic<int64_t> opMoves(0);
+vector<TypPassCounts> opPassCounts;
+vector<TypPassTimes> passTimes;
+PerfCounterSet *passPerfSet = NULL;
+
+vector<TypSortEngine> allEngines;
+
+// Functors wrapping the comparison functions for the template sorts.
+struct ElementGreater {
+    bool operator()(const ArrayElementType &first, const ArrayElementType &second) const {
+        return elementGreaterThan(first, second);
+    }
+};
+
+struct KeyPtrGreater {
+    bool operator()(const KeyPtrElement &first, const KeyPtrElement &second) const {
+        return keyPtrGreaterThan(first, second);
+    }
+};
+
+// Compares records given by the address of their first byte.
+struct SortKeyGreater {
+    bool operator()(const char *first, const char *second) const {
+        return keyGreater(sortKey, first, second);
+    }
+};
+
+// Prefetches the record an element points to, for blockedShellSortT.
+struct ElementPrefetch {
+    void operator()(const ArrayElementType &elem) const {
+        __builtin_prefetch(elem->data);
+    }
+};
+
+// Adapts a "greater than" functor to the "less than" that std::sort expects.
+template<typename Greater>
+struct LessFromGreater {
+    template<typename T>
+    bool operator()(const T &first, const T &second) const {
+        return Greater()(second, first);
+    }
+};
+
+void engineShellSort(ArrayElementType a[], int64_t n, const TypSortParams &params)
 {
-    sb_timer_t elapsedNs;
-    TypGap gapType;
-    int iGapType;
-    for(gapType=GAP_CIURA_22; gapType<GAP_MAX; (iGapType = (int) gapType, iGapType++, gapType = (TypGap) iGapType)) {
-        printf("Using ShellSort with gap sequence %s\n", nameOfGapType(gapType));
-        string sortName = "ShellSort";
-        sortName += nameOfGapType(gapType);
-        int64_t *gaps = allGaps[gapType];
-        for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
-            for(int64_t add=0; add<2; add++) {
-                int64_t n = nOrig + add;
-                for(int loop=0; loop<settings.loopCt/2; loop++) {
-                    uint64_t seed = settings.seed + loop;
-                    setRandomSeed(seed);
-                    bool bOK = doOneSort(n, gaps, elapsedNs);
-                    writeLogRec(sortName.c_str(), n, seed, elapsedNs, bOK);
-                    double elapsedSecs = 0.000000001 * elapsedNs;
-                    double recsPerSec = n / elapsedSecs;
-                    printf("%s size %lld seed %lld took %f sec for %.1f recs/sec; ret %s\n",
-                           nameOfGapType(gapType), n, seed, elapsedSecs, recsPerSec, bOK ? "true":"false");
-                }
-            }
-        }
+    if(params.bTimePasses) {
+        shellSortT(a, n, params.gaps, ElementGreater(), TimingPassHook());
+    } else {
+        shellSort(a, n, params.gaps);
     }
 }
 
-//=====  Test functions  ==============================================
+void engineShellSortRecords(char *records, int64_t n, size_t recSize, const TypSortParams &params)
+{
+    shellSortRecords(records, n, recSize, params.gaps, SortKeyGreater());
+}
 
-void printArray(ArrayElementType * pArray, int64_t n)
+template<typename T, typename Greater, typename Prefetch>
+void engineBlockedShellSort(T a[], int64_t n, const TypSortParams &params)
 {
-    for(int irec=0; irec<n; irec++) {
-        printf("%3d: ", irec);
-        for(int ichar=0; ichar<sizeof(pArray[0]->data); ichar++) {
-            putchar(pArray[irec]->data[ichar]);
-        }
-        putchar('\n');
-    }
+    blockedShellSortT(a, n, params.gaps, Greater(), Prefetch());
 }
 
-void testTimer()
+template<const auto &GAPS, typename T, typename Greater>
+void engineConstShellSort(T a[], int64_t n, const TypSortParams &params)
 {
-    sb_timer_t start = getCurrentNanoseconds();
-    usleep(10000);
-    sb_timer_t stop = getCurrentNanoseconds();
-    sb_timer_t elapsed = stop - start;
-    printf("usleep(10000) gave elapsed %lld ns\n", elapsed);
-    start = getCurrentNanoseconds();
-    stop = getCurrentNanoseconds();
-    elapsed = stop - start;
-    printf("Two consec calls gave elapsed %lld ns\n", elapsed);
+    shellSortFixedT<GAPS>(a, n, Greater());
 }
 
-void testRNG()
+void engineShellSortKeyPtr(KeyPtrElement a[], int64_t n, const TypSortParams &params)
 {
-    printf("Testing ability to reset PRNG:\n");
-    for(int loop=0; loop<3; loop++) {
-        setRandomSeed(762);
-        printf("Loop %d: ", loop);
-        for(int j=0; j<71; j++) {
-            putchar(getRandomChar());
-        }
-        putchar('\n');
-    }
-    setRandomSeed(762);
-    printf("Now let the PRNG generator run longer:\n");
-    for(int j=0; j<1000; j++) {
-        putchar(getRandomChar());
+    if(params.bTimePasses) {
+        shellSortT(a, n, params.gaps, KeyPtrGreater(), TimingPassHook());
+    } else {
+        shellSortT(a, n, params.gaps, KeyPtrGreater());
     }
-    putchar('\n');
 }
 
-void testOrder()
+// Counts are also recorded for each gap pass.
+void engineShellSortCounted(CountedElement a[], int64_t n, const TypSortParams &params)
 {
-    DataRecord *arrayData;
-    int nElements = 3;
-    ArrayElementType * pArray = createArray(nElements, arrayData);
+    shellSortT(a, n, params.gaps, CountingGreater<ElementGreater>(), CountingPassHook());
+}
+
+template<typename T, typename Greater>
+void engineParShellSort(T a[], int64_t n, const TypSortParams &params)
+{
+    parallelShellSortT(a, n, params.gaps, params.nThreads, Greater());
+}
+
+template<typename T, typename Greater>
+void engineParMergeSort(T a[], int64_t n, const TypSortParams &params)
+{
+    parallelMergeSortT(a, n, params.nThreads, Greater());
+}
+
+template<typename T, typename Greater>
+void engineStdSort(T a[], int64_t n, const TypSortParams &params)
+{
+    std::sort(a, a+n, LessFromGreater<Greater>());
+}
+
+template<typename T, typename Greater>
+void engineStdStableSort(T a[], int64_t n, const TypSortParams &params)
+{
+    std::stable_sort(a, a+n, LessFromGreater<Greater>());
+}
+
+// The number of smallest elements a TopK engine puts in order.
+inline int64_t topKOf(int64_t n, const TypSortParams &params)
+{
+    return params.topK > 0 && params.topK < n ? params.topK : n;
+}
+
+template<typename T, typename Greater>
+void engineTopKHeap(T a[], int64_t n, const TypSortParams &params)
+{
+    topKHeapT(a, n, topKOf(n, params), Greater());
+}
+
+template<typename T, typename Greater>
+void engineTopKPartialSort(T a[], int64_t n, const TypSortParams &params)
+{
+    std::partial_sort(a, a+topKOf(n, params), a+n, LessFromGreater<Greater>());
+}
+
+template<typename T, typename Greater>
+void engineTopKSelect(T a[], int64_t n, const TypSortParams &params)
+{
+    topKSelectT(a, n, topKOf(n, params), Greater());
+}
+
+template<typename T, typename Greater>
+void engineTopKShellSort(T a[], int64_t n, const TypSortParams &params)
+{
+    topKShellSortT(a, n, topKOf(n, params), params.gaps, Greater());
+}
+
+template<typename T, typename Greater>
+void engineIntroSort(T a[], int64_t n, const TypSortParams &params)
+{
+    introSortT(a, n, Greater());
+}
+
+template<typename T, typename Greater>
+void enginePdqSort(T a[], int64_t n, const TypSortParams &params)
+{
+    pdqSortT(a, n, Greater());
+}
+
+template<typename T, typename Greater>
+void engineHeapSort(T a[], int64_t n, const TypSortParams &params)
+{
+    heapSortT(a, n, Greater());
+}
+
+template<typename T, typename Greater>
+void engineMergeSort(T a[], int64_t n, const TypSortParams &params)
+{
+    mergeSortT(a, n, Greater());
+}
+
+struct ElementKeyOf {
+    const unsigned char *operator()(const ArrayElementType &elem) const {
+        return (const unsigned char *) elem->data + sortKey.off;
+    }
+};
+
+template<typename T>
+void engineRadixSort(T a[], int64_t n, const TypSortParams &params)
+{
+    radixSortT(a, n, sortKey.len, possibleChars, params.radixBits, ElementKeyOf());
+}
+
+void addEngine(const string &name, TypSortFunc func, TypKeyPtrSortFunc funcKeyPtr,
+               TypCountedSortFunc funcCounted, TypSortParams params = TypSortParams(),
+               TypRecordSortFunc funcRecords = NULL)
+{
+    TypSortEngine engine;
+    engine.name = name;
+    engine.func = func;
+    engine.funcKeyPtr = funcKeyPtr;
+    engine.funcCounted = funcCounted;
+    engine.funcRecords = funcRecords;
+    engine.params = params;
+    allEngines.push_back(engine);
+}
+
+// Add the ConstShellSort engine for a gap sequence.  params.gaps is set
+// for reference; the sort uses GAPS.
+template<const auto &GAPS>
+void addConstShellSortEngine(TypGap gapType)
+{
+    TypSortParams params;
+    params.gaps = allGaps[gapType];
+    addEngine(string("ConstShellSort") + nameOfGapType(gapType),
+              engineConstShellSort<GAPS, ArrayElementType, ElementGreater>,
+              engineConstShellSort<GAPS, KeyPtrElement, KeyPtrGreater>,
+              engineConstShellSort<GAPS, CountedElement, CountingGreater<ElementGreater>>, params);
+}
+
+// Fill allEngines.  Must be called after buildGaps().
+void buildEngines(const TypSettings &settings)
+{
+    typedef CountingGreater<ElementGreater> CountingElementGreater;
+    int iGapType;
+    for(TypGap gapType=GAP_CIURA_22; gapType<GAP_MAX;
+        (iGapType = (int) gapType, iGapType++, gapType = (TypGap) iGapType)) {
+        TypSortParams params;
+        params.gaps = allGaps[gapType];
+        params.bTimePasses = settings.bPasses;
+        addEngine(string("ShellSort") + nameOfGapType(gapType), engineShellSort, engineShellSortKeyPtr,
+                  engineShellSortCounted, params, engineShellSortRecords);
+    }
+    for(TypGap gapType=GAP_CIURA_22; gapType<GAP_MAX;
+        (iGapType = (int) gapType, iGapType++, gapType = (TypGap) iGapType)) {
+        TypSortParams params;
+        params.gaps = allGaps[gapType];
+        params.nThreads = settings.nThreads;
+        addEngine(string("ParShellSort") + nameOfGapType(gapType),
+                  engineParShellSort<ArrayElementType, ElementGreater>,
+                  engineParShellSort<KeyPtrElement, KeyPtrGreater>,
+                  engineParShellSort<CountedElement, CountingElementGreater>, params);
+    }
+    addEngine("StdSort", engineStdSort<ArrayElementType, ElementGreater>,
+              engineStdSort<KeyPtrElement, KeyPtrGreater>,
+              engineStdSort<CountedElement, CountingElementGreater>);
+    addEngine("StdStableSort", engineStdStableSort<ArrayElementType, ElementGreater>,
+              engineStdStableSort<KeyPtrElement, KeyPtrGreater>,
+              engineStdStableSort<CountedElement, CountingElementGreater>);
+    addEngine("IntroSort", engineIntroSort<ArrayElementType, ElementGreater>,
+              engineIntroSort<KeyPtrElement, KeyPtrGreater>,
+              engineIntroSort<CountedElement, CountingElementGreater>);
+    addEngine("PdqSort", enginePdqSort<ArrayElementType, ElementGreater>,
+              enginePdqSort<KeyPtrElement, KeyPtrGreater>,
+              enginePdqSort<CountedElement, CountingElementGreater>);
+    addEngine("HeapSort", engineHeapSort<ArrayElementType, ElementGreater>,
+              engineHeapSort<KeyPtrElement, KeyPtrGreater>,
+              engineHeapSort<CountedElement, CountingElementGreater>);
+    addEngine("MergeSort", engineMergeSort<ArrayElementType, ElementGreater>,
+              engineMergeSort<KeyPtrElement, KeyPtrGreater>,
+              engineMergeSort<CountedElement, CountingElementGreater>);
+    TypSortParams radixParams;
+    radixParams.radixBits = settings.radixBits;
+    addEngine("RadixSort", engineRadixSort<ArrayElementType>, NULL,
+              engineRadixSort<CountedElement>, radixParams);
+    addConstShellSortEngine<CONST_GAPS_CIURA_22>(GAP_CIURA_22);
+    addConstShellSortEngine<CONST_GAPS_CIURA_225>(GAP_CIURA_225);
+    addConstShellSortEngine<CONST_GAPS_CIURA_225_ODD>(GAP_CIURA_225_ODD);
+    addConstShellSortEngine<CONST_GAPS_CIURA_235>(GAP_CIURA_235);
+    addConstShellSortEngine<CONST_GAPS_JDAW1>(GAP_JDAW1);
+    addConstShellSortEngine<CONST_GAPS_KNUTH73>(GAP_KNUTH73);
+    addConstShellSortEngine<CONST_GAPS_LEE21>(GAP_LEE21);
+    addConstShellSortEngine<CONST_GAPS_TOKUDA92>(GAP_TOKUDA92);
+    for(TypGap gapType=GAP_CIURA_22; gapType<GAP_MAX;
+        (iGapType = (int) gapType, iGapType++, gapType = (TypGap) iGapType)) {
+        TypSortParams params;
+        params.gaps = allGaps[gapType];
+        addEngine(string("BlockedShellSort") + nameOfGapType(gapType),
+                  engineBlockedShellSort<ArrayElementType, ElementGreater, ElementPrefetch>,
+                  engineBlockedShellSort<KeyPtrElement, KeyPtrGreater, NoElementPrefetch>,
+                  engineBlockedShellSort<CountedElement, CountingElementGreater, NoElementPrefetch>, params);
+    }
+    TypSortParams parParams;
+    parParams.nThreads = settings.nThreads;
+    addEngine("ParMergeSort", engineParMergeSort<ArrayElementType, ElementGreater>,
+              engineParMergeSort<KeyPtrElement, KeyPtrGreater>,
+              engineParMergeSort<CountedElement, CountingElementGreater>, parParams);
+    TypSortParams topKParams;
+    topKParams.gaps = allGaps[GAP_CIURA_225_ODD];
+    addEngine("TopKHeap", engineTopKHeap<ArrayElementType, ElementGreater>,
+              engineTopKHeap<KeyPtrElement, KeyPtrGreater>,
+              engineTopKHeap<CountedElement, CountingElementGreater>, topKParams);
+    addEngine("TopKPartialSort", engineTopKPartialSort<ArrayElementType, ElementGreater>,
+              engineTopKPartialSort<KeyPtrElement, KeyPtrGreater>,
+              engineTopKPartialSort<CountedElement, CountingElementGreater>, topKParams);
+    addEngine("TopKSelect", engineTopKSelect<ArrayElementType, ElementGreater>,
+              engineTopKSelect<KeyPtrElement, KeyPtrGreater>,
+              engineTopKSelect<CountedElement, CountingElementGreater>, topKParams);
+    addEngine("TopKShellSort", engineTopKShellSort<ArrayElementType, ElementGreater>,
+              engineTopKShellSort<KeyPtrElement, KeyPtrGreater>,
+              engineTopKShellSort<CountedElement, CountingElementGreater>, topKParams);
+    // Every engine knows K, so that its results are checked and logged as top-K.
+    for(TypSortEngine &engine : allEngines) {
+        engine.params.topK = settings.topK;
+    }
+}
+
+// Returns true if an engine name matches one item of the -algo list.
+// Matching is case-insensitive; a trailing * matches any suffix.
+bool engineNameMatches(const string &name, const string &pattern)
+{
+    if("all" == pattern) return true;
+    if(!pattern.empty() && '*' == pattern.back()) {
+        size_t len = pattern.size() - 1;
+        return name.size() >= len && 0 == strncasecmp(name.c_str(), pattern.c_str(), len);
+    }
+    return 0 == strcasecmp(name.c_str(), pattern.c_str());
+}
+
+// Build the list of engines requested by a comma-separated -algo list,
+// in registry order.  Returns false if an item matches no engine.
+bool selectEngines(const string &algoList, vector<TypSortEngine> &selected)
+{
+    bool bOK=true;
+    vector<string> patterns;
+    size_t start = 0;
+    for(;;) {
+        size_t comma = algoList.find(',', start);
+        patterns.push_back(algoList.substr(start, string::npos==comma ? string::npos : comma-start));
+        if(string::npos == comma) break;
+        start = comma + 1;
+    }
+    for(const string &pattern : patterns) {
+        bool bFound = false;
+        for(const TypSortEngine &engine : allEngines) {
+            if(engineNameMatches(engine.name, pattern)) {
+                bFound = true;
+                break;
+            }
+        }
+        if(!bFound) {
+            printf("Unrecognized sort engine: %s\n", pattern.c_str());
+            bOK = false;
+        }
+    }
+    selected.clear();
+    for(const TypSortEngine &engine : allEngines) {
+        for(const string &pattern : patterns) {
+            if(engineNameMatches(engine.name, pattern)) {
+                selected.push_back(engine);
+                break;
+            }
+        }
+    }
+    return bOK;
+}
+
+// Sort pArray with an engine, using the given array layout.
+// For LAYOUT_KEYPTR, building the (key, pointer) array and copying the
+// sorted pointers back are part of the work, so callers time them too.
+// keyArray must have room for n elements; it is unused for LAYOUT_PTR.
+void runEngine(const TypSortEngine &engine, const TypSortParams &params, TypLayout layout,
+               ArrayElementType *pArray, int64_t n, KeyPtrElement *keyArray)
+{
+    if(LAYOUT_KEYPTR == layout) {
+        for(int64_t j=0; j<n; j++) {
+            keyArray[j].key = keyPrefix(pArray[j]);
+            keyArray[j].rec = pArray[j];
+        }
+        engine.funcKeyPtr(keyArray, n, params);
+        for(int64_t j=0; j<n; j++) {
+            pArray[j] = keyArray[j].rec;
+        }
+    } else {
+        engine.func(pArray, n, params);
+    }
+}
+
+// Returns the name under which results for an engine, layout and record
+// size are logged.
+string logNameOf(const TypSortEngine &engine, TypLayout layout, size_t recSize = sizeof(DataRecord))
+{
+    const char *suffixes[LAYOUT_MAX] = {"", "KeyPtr", "Records", "Permute"};
+    string name = engine.name + suffixes[layout];
+    if(recSize != sizeof(DataRecord)) {
+        name += to_string(recSize);
+    }
+    if(sortKey.off != 0 || sortKey.len != KEY_LEN_DEFAULT) {
+        name += "Key" + to_string(sortKey.len);
+        if(sortKey.off != 0) name += "At" + to_string(sortKey.off);
+    }
+    if(engine.params.topK > 0) {
+        name += "Top" + to_string(engine.params.topK);
+    }
+    // Timing the passes adds to the time of the whole sort, so such sorts
+    // are kept apart from plain ones.
+    if(engine.params.bTimePasses && (LAYOUT_PTR == layout || LAYOUT_KEYPTR == layout)) {
+        name += "Passes";
+    }
+    return name;
+}
+
+bool engineSupportsLayout(const TypSortEngine &engine, TypLayout layout)
+{
+    if(LAYOUT_KEYPTR == layout) return NULL != engine.funcKeyPtr;
+    if(LAYOUT_RECORDS == layout) return NULL != engine.funcRecords;
+    return true;
+}
+
+//=====  Records of other sizes  ======================================
+
+// Returns n records of recSize bytes with the keys createArray would
+// generate.  The bytes after the key repeat the generated record's bytes.
+char *createSizedRecords(int64_t n, size_t recSize)
+{
+    DataRecord *arrayData;
+    ArrayElementType *pArray = createArray(n, arrayData);
+    char *records = new char[n*recSize];
+    const size_t nChars = sizeof(arrayData[0].data) - 1;
+    for(int64_t j=0; j<n; j++) {
+        char *rec = records + j*recSize;
+        for(size_t ichar=0; ichar<recSize-1; ichar++) {
+            rec[ichar] = arrayData[j].data[ichar % nChars];
+        }
+        rec[recSize-1] = '\0';
+    }
+    delete []arrayData;
+    delete []pArray;
+    return records;
+}
+
+// Returns a checksum of n records of recSize bytes that does not depend on
+// their order: the sum of an FNV-1a hash of each record.
+uint64_t recordsChecksum(const char *records, int64_t n, size_t recSize)
+{
+    uint64_t sum = 0;
+    for(int64_t j=0; j<n; j++) {
+        const unsigned char *rec = (const unsigned char *) (records + j*recSize);
+        uint64_t hash = 14695981039346656037ULL;
+        for(size_t ichar=0; ichar<recSize; ichar++) {
+            hash = (hash ^ rec[ichar]) * 1099511628211ULL;
+        }
+        sum += hash;
+    }
+    return sum;
+}
+
+// Checks that the records are in order, and, by their checksum, that they
+// are the records that were sorted.
+bool checkRecordsOrder(const char *records, int64_t n, size_t recSize, uint64_t checksum)
+{
+    for(int64_t j=1; j<n; j++) {
+        if(keyGreater(sortKey, records + (j-1)*recSize, records + j*recSize)) return false;
+    }
+    return recordsChecksum(records, n, recSize) == checksum;
+}
+
+// Like doOneSort, for records of recSize bytes in any layout.
+// For LAYOUT_PERMUTE, the copy into sorted order is timed with the sort.
+bool doOneSizedSort(int64_t n, const TypSortEngine &engine, TypLayout layout, size_t recSize,
+                    sb_timer_t &elapsedNs, PerfCounterSet *pPerf, TypPerfCounts &perfCounts)
+{
+    bool bOK;
+    char *records = createSizedRecords(n, recSize);
+    uint64_t checksum = recordsChecksum(records, n, recSize);
+    ArrayElementType *pArray = NULL;
+    KeyPtrElement *keyArray = NULL;
+    char *permuted = NULL;
+    if(LAYOUT_RECORDS != layout) {
+        // Comparisons only read the key, so the pointers may point to records
+        // of any size.
+        pArray = new ArrayElementType[n];
+        for(int64_t j=0; j<n; j++) {
+            pArray[j] = (ArrayElementType) (records + j*recSize);
+        }
+    }
+    if(LAYOUT_KEYPTR == layout) keyArray = new KeyPtrElement[n];
+    if(LAYOUT_PERMUTE == layout) {
+        // Fault the destination in now, not during the timed copy.
+        permuted = new char[n*recSize];
+        memset(permuted, 0, n*recSize);
+    }
+    if(NULL != pPerf) perfStart(pPerf);
+    uint64_t start = timerStart();
+    if(LAYOUT_RECORDS == layout) {
+        engine.funcRecords(records, n, recSize, engine.params);
+    } else {
+        runEngine(engine, engine.params, LAYOUT_KEYPTR == layout ? LAYOUT_KEYPTR : LAYOUT_PTR, pArray, n, keyArray);
+        if(LAYOUT_PERMUTE == layout) {
+            permuteRecords(pArray, n, recSize, permuted);
+        }
+    }
+    elapsedNs = timerElapsedNs(start);
+    if(NULL != pPerf) perfStop(pPerf, &perfCounts);
+    if(LAYOUT_RECORDS == layout) {
+        bOK = checkRecordsOrder(records, n, recSize, checksum);
+    } else if(LAYOUT_PERMUTE == layout) {
+        bOK = checkRecordsOrder(permuted, n, recSize, checksum);
+    } else {
+        bOK = checkTopKOrder(pArray, n, engine.params.topK);
+    }
+    delete []records;
+    delete []pArray;
+    delete []keyArray;
+    delete []permuted;
+    return bOK;
+}
+
+// Returns the number of bytes of arena doSorts needs for arrays of n elements.
+size_t arenaBytesForSort(int64_t n, const vector<TypLayout> &layouts)
+{
+    size_t bytesPerElement = sizeof(DataRecord) + sizeof(ArrayElementType);
+    if(std::find(layouts.begin(), layouts.end(), LAYOUT_KEYPTR) != layouts.end()) {
+        bytesPerElement += sizeof(KeyPtrElement);
+    }
+    return n*bytesPerElement + 3*ARENA_ALIGN;
+}
+
+// If pArena is not NULL, the arrays are carved from it; otherwise they are
+// allocated with new and freed afterwards.  Records of other than the
+// standard size, and the record-moving layouts, don't use the arena.
+// If pPerf is not NULL, hardware counters for the sort are read into perfCounts.
+bool doOneSort(int64_t n, const TypSortEngine &engine, TypLayout layout, size_t recSize, Arena *pArena,
+               sb_timer_t &elapsedNs, PerfCounterSet *pPerf, TypPerfCounts &perfCounts)
+{
+    bool bOK=true;
+    if(recSize != sizeof(DataRecord) || LAYOUT_RECORDS == layout || LAYOUT_PERMUTE == layout) {
+        return doOneSizedSort(n, engine, layout, recSize, elapsedNs, pPerf, perfCounts);
+    }
+    DataRecord *arrayData;
+    ArrayElementType * pArray;
+    KeyPtrElement *keyArray = NULL;
+    if(NULL != pArena) {
+        arenaReset(pArena);
+        arrayData = arenaAllocArray<DataRecord>(pArena, n);
+        pArray = arenaAllocArray<ArrayElementType>(pArena, n);
+        if(LAYOUT_KEYPTR == layout) keyArray = arenaAllocArray<KeyPtrElement>(pArena, n);
+        fillArray(n, arrayData, pArray);
+    } else {
+        pArray = createArray(n, arrayData);
+        if(LAYOUT_KEYPTR == layout) keyArray = new KeyPtrElement[n];
+    }
+    if(NULL != pPerf) perfStart(pPerf);
+    uint64_t start = timerStart();
+    runEngine(engine, engine.params, layout, pArray, n, keyArray);
+    elapsedNs = timerElapsedNs(start);
+    if(NULL != pPerf) perfStop(pPerf, &perfCounts);
+    bOK = checkTopKOrder(pArray, n, engine.params.topK);
+    if(NULL == pArena) {
+        delete []arrayData;
+        delete []pArray;
+        delete []keyArray;
+    }
+    return bOK;
+}
+
+// Returns the largest array size the -sizemin, -sizemult and -sizemax
+// settings give, not counting the +1 variant.
+int64_t largestArraySize(const TypSettings &settings)
+{
+    int64_t nLargest = settings.arraySizeMin;
+    while(settings.arraySizeMult > 1 && nLargest*settings.arraySizeMult <= settings.arraySizeMax) {
+        nLargest *= settings.arraySizeMult;
+    }
+    return nLargest;
+}
+
+// Log and print the result of one timed sort.
+// pPerfCounts is NULL if hardware counters are not in use.
+void reportSort(const TypSettings &settings, const TypSortEngine &engine, const char *sortName, int64_t n,
+                uint64_t seed, sb_timer_t elapsedNs, bool bOK, const TypPerfCounts *pPerfCounts)
+{
+    writeLogRec(sortName, n, seed, elapsedNs, bOK, nameOfDist(settings.dist), engine.params.nThreads, pPerfCounts);
+    double elapsedSecs = 0.000000001 * elapsedNs;
+    double recsPerSec = n / elapsedSecs;
+    printf("%s size %lld seed %lld took %f sec for %.1f recs/sec; ret %s\n",
+           sortName, n, seed, elapsedSecs, recsPerSec, bOK ? "true":"false");
+    if(NULL != pPerfCounts) {
+        printf("   ");
+        for(int j=0; j<PERF_NUM_COUNTERS; j++) {
+            printf(" %s %.3f/rec", nameOfPerfCounter((TypPerfCounter) j),
+                   pPerfCounts->counts[j] < 0 ? -1.0 : (double) pPerfCounts->counts[j] / n);
+        }
+        printf("\n");
+    }
+}
+
+// Write the passes of a sort timed with -passes, and print a summary.
+// bPerf is true if passTimes has hardware counts.
+void reportPasses(FILE *filePasses, const char *sortName, int64_t n, int64_t seed, bool bOK, bool bPerf)
+{
+    sb_timer_t totalNs = 0;
+    for(const TypPassTimes &pass : passTimes) {
+        fprintf(filePasses, "%s,%lld,%lld,%lld,%lld,%s", sortName, n, seed, pass.gap, pass.elapsedNs,
+                bOK ? "true":"false");
+        if(bPerf) {
+            perfWriteCSV(filePasses, &pass.perfCounts);
+        }
+        fprintf(filePasses, "\n");
+        totalNs += pass.elapsedNs;
+    }
+    if(passTimes.empty() || 0 == totalNs) return;
+    printf("    %d passes; first (gap %lld) %.1f%%, last (gap %lld) %.1f%% of the pass time\n",
+           (int) passTimes.size(), passTimes.front().gap, 100.0 * passTimes.front().elapsedNs / totalNs,
+           passTimes.back().gap, 100.0 * passTimes.back().elapsedNs / totalNs);
+}
+
+void doSorts(TypSettings settings, const vector<TypSortEngine> &engines)
+{
+    sb_timer_t elapsedNs;
+    PerfCounterSet perfSet;
+    PerfCounterSet *pPerf = NULL;
+    TypPerfCounts perfCounts;
+    if(settings.bPerf) {
+        if(perfOpen(&perfSet)) {
+            pPerf = &perfSet;
+        } else {
+            printf("Hardware performance counters are not available; ignoring -perf\n");
+        }
+    }
+    // With -passes, any counters are read around each pass instead.
+    FILE *filePasses = NULL;
+    PerfCounterSet *pSortPerf = pPerf;
+    if(settings.bPasses) {
+        filePasses = fopen(settings.passFile.c_str(), "a");
+        if(NULL == filePasses) {
+            printf("Cannot open %s; not timing passes\n", settings.passFile.c_str());
+        } else {
+            passPerfSet = pPerf;
+            pSortPerf = NULL;
+        }
+    }
+    // One arena, sized for the largest array, serves every sort.
+    Arena arena;
+    Arena *pArena = NULL;
+    if(settings.bArena) {
+        size_t bytes = arenaBytesForSort(largestArraySize(settings)+1, settings.layouts);
+        if(arenaInit(&arena, bytes, settings.hugePages, settings.bPrefault)) {
+            pArena = &arena;
+            if(arena.pages != settings.hugePages) {
+                printf("Huge pages of type %s are not available; using %s\n",
+                       nameOfHugePages(settings.hugePages), nameOfHugePages(arena.pages));
+            }
+        } else {
+            printf("Cannot map %zu bytes; allocating each sort's arrays separately\n", bytes);
+        }
+    }
+    if(DIST_UNIFORM != settings.dist) {
+        printf("Keys follow distribution %s\n", nameOfDist(settings.dist));
+    }
+    for(const TypSortEngine &engine : engines) {
+        for(TypLayout layout : settings.layouts) {
+            if(!engineSupportsLayout(engine, layout)) {
+                printf("Sort engine %s does not support layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+                continue;
+            }
+            printf("Using sort engine %s with layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+            bool bPassesTimed = engine.params.bTimePasses && (LAYOUT_PTR == layout || LAYOUT_KEYPTR == layout);
+            if(NULL != filePasses && !bPassesTimed) {
+                printf("Passes are not timed for sort engine %s with layout %s\n", engine.name.c_str(),
+                       nameOfLayout(layout));
+            }
+            for(int recSize : settings.recordSizes) {
+                string logName = logNameOf(engine, layout, recSize);
+                const char *sortName = logName.c_str();
+                for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
+                    for(int64_t add=0; add<2; add++) {
+                        int64_t n = nOrig + add;
+                        for(int warm=0; warm<settings.warmup; warm++) {
+                            setRandomSeed(settings.seed + warm);
+                            doOneSort(n, engine, layout, recSize, pArena, elapsedNs, NULL, perfCounts);
+                        }
+                        vector<double> recsPerSec;
+                        for(int loop=0; loop<settings.loopCt/2; loop++) {
+                            uint64_t seed = settings.seed + loop;
+                            setRandomSeed(seed);
+                            passTimes.clear();
+                            passTimes.reserve(NUM_GAPS);
+                            bool bOK = doOneSort(n, engine, layout, recSize, pArena, elapsedNs, pSortPerf, perfCounts);
+                            reportSort(settings, engine, sortName, n, seed, elapsedNs, bOK,
+                                       pSortPerf ? &perfCounts : NULL);
+                            if(NULL != filePasses && bPassesTimed) {
+                                reportPasses(filePasses, sortName, n, seed, bOK, NULL != passPerfSet);
+                            }
+                            if(settings.ciTarget > 0) {
+                                recsPerSec.push_back(n / (0.000000001 * elapsedNs));
+                                if((int) recsPerSec.size() >= settings.minLoops) {
+                                    TypStats stats;
+                                    statsCompute(recsPerSec, stats);
+                                    if(statsRelativeCIWidth(stats) <= settings.ciTarget) break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if(NULL != filePasses) {
+        fclose(filePasses);
+        passPerfSet = NULL;
+    }
+    if(NULL != pPerf) {
+        perfClose(pPerf);
+    }
+    if(NULL != pArena) {
+        arenaFree(pArena);
+    }
+}
+
+//=====  Pipelined driver  ============================================
+// With -pipeline, the untimed work of doSorts moves off the timing thread.
+// A producer thread generates the records for upcoming sorts while the
+// main thread sorts, and a consumer thread checks each sorted array, logs
+// the result and frees the array.  Arrays circulate through PIPE_SLOTS
+// slots: one being filled, one being sorted and one being checked.
+// The helper threads share one CPU, and the main thread, with any threads
+// a sort starts, is kept off it.
+
+const int PIPE_SLOTS = 3;
+
+enum TypSlotState {SLOT_EMPTY, SLOT_READY, SLOT_SORTED};
+
+// One of the sorts doSorts would run, in the same order.
+struct TypPipeJob {
+    const TypSortEngine *pEngine;
+    TypLayout   layout;
+    string      sortName;
+    int64_t     n;
+    uint64_t    seed;
+};
+
+struct TypPipeSlot {
+    TypSlotState state = SLOT_EMPTY;
+    Arena       arena;
+    bool        bArena = false;     // Whether the arrays are carved from arena.
+    DataRecord  *arrayData = NULL;
+    ArrayElementType *pArray = NULL;
+    KeyPtrElement *keyArray = NULL;
+    sb_timer_t  elapsedNs = 0;
+    TypPerfCounts perfCounts;
+};
+
+struct TypPipeline {
+    std::mutex  lock;
+    std::condition_variable changed;
+    TypPipeSlot slots[PIPE_SLOTS];
+    vector<TypPipeJob> jobs;
+    bool        bPerf = false;
+    int         helperCpu = -1;     // CPU for the helper threads, or -1.
+};
+
+void pipeWaitFor(TypPipeline &pipe, TypPipeSlot &slot, TypSlotState state)
+{
+    std::unique_lock<std::mutex> guard(pipe.lock);
+    pipe.changed.wait(guard, [&] { return slot.state == state; });
+}
+
+void pipeSetState(TypPipeline &pipe, TypPipeSlot &slot, TypSlotState state)
+{
+    {
+        std::lock_guard<std::mutex> guard(pipe.lock);
+        slot.state = state;
+    }
+    pipe.changed.notify_all();
+}
+
+// Generate each job's records into its slot once the slot is free.
+// Only this thread uses the random number generator.
+void pipeProducer(TypPipeline *pipe)
+{
+    if(pipe->helperCpu >= 0) affinityPinCurrentThread(pipe->helperCpu);
+    for(size_t j=0; j<pipe->jobs.size(); j++) {
+        const TypPipeJob &job = pipe->jobs[j];
+        TypPipeSlot &slot = pipe->slots[j % PIPE_SLOTS];
+        pipeWaitFor(*pipe, slot, SLOT_EMPTY);
+        if(slot.bArena) {
+            arenaReset(&slot.arena);
+            slot.arrayData = arenaAllocArray<DataRecord>(&slot.arena, job.n);
+            slot.pArray = arenaAllocArray<ArrayElementType>(&slot.arena, job.n);
+            slot.keyArray = LAYOUT_KEYPTR == job.layout ? arenaAllocArray<KeyPtrElement>(&slot.arena, job.n) : NULL;
+        } else {
+            slot.arrayData = new DataRecord[job.n];
+            slot.pArray = new ArrayElementType[job.n];
+            slot.keyArray = LAYOUT_KEYPTR == job.layout ? new KeyPtrElement[job.n] : NULL;
+        }
+        setRandomSeed(job.seed);
+        fillArray(job.n, slot.arrayData, slot.pArray);
+        pipeSetState(*pipe, slot, SLOT_READY);
+    }
+}
+
+// Check, report and free each job's array once it has been sorted.
+// Only this thread writes the log.
+void pipeConsumer(TypPipeline *pipe, const TypSettings *pSettings)
+{
+    if(pipe->helperCpu >= 0) affinityPinCurrentThread(pipe->helperCpu);
+    for(size_t j=0; j<pipe->jobs.size(); j++) {
+        const TypPipeJob &job = pipe->jobs[j];
+        TypPipeSlot &slot = pipe->slots[j % PIPE_SLOTS];
+        pipeWaitFor(*pipe, slot, SLOT_SORTED);
+        bool bOK = checkTopKOrder(slot.pArray, job.n, job.pEngine->params.topK);
+        reportSort(*pSettings, *job.pEngine, job.sortName.c_str(), job.n, job.seed, slot.elapsedNs, bOK,
+                   pipe->bPerf ? &slot.perfCounts : NULL);
+        if(!slot.bArena) {
+            delete []slot.arrayData;
+            delete []slot.pArray;
+            delete []slot.keyArray;
+        }
+        pipeSetState(*pipe, slot, SLOT_EMPTY);
+    }
+}
+
+// Run the same sorts as doSorts, with generation and checking overlapped
+// with the timed sorts.  Supports 72-byte records in the ptr and keyptr
+// layouts.
+void doPipelinedSorts(const TypSettings &settings, const vector<TypSortEngine> &engines)
+{
+    TypPipeline pipe;
+    for(const TypSortEngine &engine : engines) {
+        for(TypLayout layout : settings.layouts) {
+            if(!engineSupportsLayout(engine, layout)) {
+                printf("Sort engine %s does not support layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+                continue;
+            }
+            printf("Using sort engine %s with layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+            for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
+                for(int64_t add=0; add<2; add++) {
+                    for(int loop=0; loop<settings.loopCt/2; loop++) {
+                        pipe.jobs.push_back(TypPipeJob{&engine, layout, logNameOf(engine, layout), nOrig + add,
+                            (uint64_t) (settings.seed + loop)});
+                    }
+                }
+            }
+        }
+    }
+    if(settings.bArena) {
+        size_t bytes = arenaBytesForSort(largestArraySize(settings)+1, settings.layouts);
+        for(TypPipeSlot &slot : pipe.slots) {
+            slot.bArena = arenaInit(&slot.arena, bytes, settings.hugePages, settings.bPrefault);
+        }
+        if(!pipe.slots[0].bArena || !pipe.slots[PIPE_SLOTS-1].bArena) {
+            printf("Cannot map %zu bytes; allocating each sort's arrays separately\n", bytes);
+        }
+    }
+    if(DIST_UNIFORM != settings.dist) {
+        printf("Keys follow distribution %s\n", nameOfDist(settings.dist));
+    }
+
+    vector<int> cpus = affinityAllowedCpus();
+    if(cpus.size() >= 2) {
+        pipe.helperCpu = cpus.back();
+        affinitySetCurrentThread(vector<int>(cpus.begin(), cpus.end()-1));
+    } else {
+        printf("No spare CPU to pin helper threads to; generation will compete with the sorts\n");
+    }
+    std::thread producer(pipeProducer, &pipe);
+    std::thread consumer(pipeConsumer, &pipe, &settings);
+
+    // Open the counters after starting the helpers, so that they count
+    // only this thread and the threads sorts start.
+    PerfCounterSet perfSet;
+    if(settings.bPerf) {
+        pipe.bPerf = perfOpen(&perfSet);
+        if(!pipe.bPerf) {
+            printf("Hardware performance counters are not available; ignoring -perf\n");
+        }
+    }
+    for(size_t j=0; j<pipe.jobs.size(); j++) {
+        const TypPipeJob &job = pipe.jobs[j];
+        TypPipeSlot &slot = pipe.slots[j % PIPE_SLOTS];
+        pipeWaitFor(pipe, slot, SLOT_READY);
+        if(pipe.bPerf) perfStart(&perfSet);
+        uint64_t start = timerStart();
+        runEngine(*job.pEngine, job.pEngine->params, job.layout, slot.pArray, job.n, slot.keyArray);
+        slot.elapsedNs = timerElapsedNs(start);
+        if(pipe.bPerf) perfStop(&perfSet, &slot.perfCounts);
+        pipeSetState(pipe, slot, SLOT_SORTED);
+    }
+    producer.join();
+    consumer.join();
+
+    if(pipe.bPerf) {
+        perfClose(&perfSet);
+    }
+    for(TypPipeSlot &slot : pipe.slots) {
+        if(slot.bArena) arenaFree(&slot.arena);
+    }
+    if(!cpus.empty()) {
+        affinitySetCurrentThread(cpus);
+    }
+}
+
+//=====  Concurrent cells  ============================================
+// With -jobs:N, the sorts doSorts would run, each a cell of engine,
+// layout, record size, size and seed, are shared among N worker threads.
+// Each worker is pinned to its own physical core and has its own arena,
+// counters and random generator state, so a cell gives the same records
+// and result as it would alone.  The main thread reports the cells in
+// doSorts order as they finish, so the CSV is the same whatever the
+// timing.
+
+struct TypCell {
+    const TypSortEngine *pEngine;
+    TypLayout   layout;
+    int         recSize;
+    string      sortName;
+    int64_t     n;
+    uint64_t    seed;
+    // Results, valid once bDone.
+    bool        bDone = false;
+    bool        bOK = false;
+    sb_timer_t  elapsedNs = 0;
+    TypPerfCounts perfCounts;
+};
+
+struct TypCellQueue {
+    vector<TypCell> cells;
+    std::atomic<size_t> next{0};
+    std::mutex  lock;
+    std::condition_variable done;
+    bool        bPerf = false;
+};
+
+// Run cells until there are none left.  cpu is the CPU to pin to, or -1.
+void cellWorker(const TypSettings *pSettings, TypCellQueue *pQueue, int cpu, size_t bytesArena)
+{
+    if(cpu >= 0) affinityPinCurrentThread(cpu);
+    Arena arena;
+    Arena *pArena = NULL;
+    if(pSettings->bArena && arenaInit(&arena, bytesArena, pSettings->hugePages, pSettings->bPrefault)) {
+        pArena = &arena;
+    }
+    PerfCounterSet perfSet;
+    PerfCounterSet *pPerf = NULL;
+    if(pQueue->bPerf && perfOpen(&perfSet)) {
+        pPerf = &perfSet;
+    }
+    for(;;) {
+        size_t j = pQueue->next.fetch_add(1);
+        if(j >= pQueue->cells.size()) break;
+        TypCell &cell = pQueue->cells[j];
+        setRandomSeed(cell.seed);
+        TypPerfCounts perfCounts;
+        sb_timer_t elapsedNs;
+        bool bOK = doOneSort(cell.n, *cell.pEngine, cell.layout, cell.recSize, pArena, elapsedNs, pPerf, perfCounts);
+        {
+            std::lock_guard<std::mutex> guard(pQueue->lock);
+            cell.bOK = bOK;
+            cell.elapsedNs = elapsedNs;
+            cell.perfCounts = perfCounts;
+            cell.bDone = true;
+        }
+        pQueue->done.notify_all();
+    }
+    if(NULL != pPerf) {
+        perfClose(pPerf);
+    }
+    if(NULL != pArena) {
+        arenaFree(pArena);
+    }
+}
+
+// Start nJobs workers on queue, each pinned to its own physical core if
+// there are enough.
+vector<std::thread> startCellWorkers(const TypSettings &settings, TypCellQueue &queue, int nJobs, size_t bytesArena)
+{
+    vector<int> cores = affinityPhysicalCores();
+    if(cores.empty()) {
+        printf("Cannot pin workers to cores on this system\n");
+    } else if((int) cores.size() < nJobs) {
+        printf("Only %d physical cores for %d jobs; some workers will share a core\n",
+               (int) cores.size(), nJobs);
+    }
+    vector<std::thread> workers;
+    for(int ijob=0; ijob<nJobs; ijob++) {
+        int cpu = cores.empty() ? -1 : cores[ijob % cores.size()];
+        workers.emplace_back(cellWorker, &settings, &queue, cpu, bytesArena);
+    }
+    return workers;
+}
+
+void waitForCell(TypCellQueue &queue, TypCell &cell)
+{
+    std::unique_lock<std::mutex> guard(queue.lock);
+    queue.done.wait(guard, [&] { return cell.bDone; });
+}
+
+void doJobSorts(const TypSettings &settings, const vector<TypSortEngine> &engines)
+{
+    TypCellQueue queue;
+    for(const TypSortEngine &engine : engines) {
+        for(TypLayout layout : settings.layouts) {
+            if(!engineSupportsLayout(engine, layout)) {
+                printf("Sort engine %s does not support layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+                continue;
+            }
+            printf("Using sort engine %s with layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+            for(int recSize : settings.recordSizes) {
+                string logName = logNameOf(engine, layout, recSize);
+                for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
+                    for(int64_t add=0; add<2; add++) {
+                        for(int loop=0; loop<settings.loopCt/2; loop++) {
+                            TypCell cell;
+                            cell.pEngine = &engine;
+                            cell.layout = layout;
+                            cell.recSize = recSize;
+                            cell.sortName = logName;
+                            cell.n = nOrig + add;
+                            cell.seed = settings.seed + loop;
+                            queue.cells.push_back(cell);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if(DIST_UNIFORM != settings.dist) {
+        printf("Keys follow distribution %s\n", nameOfDist(settings.dist));
+    }
+    queue.bPerf = settings.bPerf;
+
+    size_t bytesArena = arenaBytesForSort(largestArraySize(settings)+1, settings.layouts);
+    vector<std::thread> workers = startCellWorkers(settings, queue, settings.nJobs, bytesArena);
+    for(TypCell &cell : queue.cells) {
+        waitForCell(queue, cell);
+        reportSort(settings, *cell.pEngine, cell.sortName.c_str(), cell.n, cell.seed, cell.elapsedNs, cell.bOK,
+                   settings.bPerf ? &cell.perfCounts : NULL);
+    }
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+//=====  External-memory sort  ========================================
+
+struct TypExtTimes {
+    sb_timer_t  sortNs;     // Sorting chunks in memory.
+    sb_timer_t  runNs;      // Writing the sorted runs.
+    sb_timer_t  mergeNs;    // Merging the runs to the output file.
+    int64_t     nRuns;
+};
+
+// Sort n records too many to hold in memory at once.  The records are
+// generated in chunks, continuing the random stream, so they are the same
+// records an in-memory sort of n would get.  Generating them is not timed.
+// The output is checked for order as it is merged.
+bool doOneExternalSort(int64_t n, const TypSortEngine &engine, TypLayout layout,
+                       const TypSettings &settings, TypExtTimes &times)
+{
+    times.sortNs = times.runNs = times.mergeNs = 0;
+    times.nRuns = 0;
+    int64_t chunk = settings.extChunk < n ? settings.extChunk : n;
+    string runFileName = settings.extDir + "/sortbench-runs-" + to_string(getpid()) + ".tmp";
+    string outFileName = settings.extDir + "/sortbench-out-" + to_string(getpid()) + ".tmp";
+    int fdRuns = open(runFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int fdOut = open(outFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fdRuns < 0 || fdOut < 0) {
+        printf("Cannot create files in %s\n", settings.extDir.c_str());
+        if(fdRuns >= 0) close(fdRuns);
+        if(fdOut >= 0) close(fdOut);
+        return false;
+    }
+    bool bOK = true;
+
+    // Form the runs, one after another in the run file.
+    DataRecord *arrayData = new DataRecord[chunk];
+    ArrayElementType *pArray = new ArrayElementType[chunk];
+    KeyPtrElement *keyArray = LAYOUT_KEYPTR == layout ? new KeyPtrElement[chunk] : NULL;
+    vector<int64_t> runLengths;
+    RunWriter writer;
+    runWriterOpen(&writer, fdRuns, 0, sizeof(DataRecord), settings.extBufRecords);
+    for(int64_t done=0; done<n; done+=chunk) {
+        int64_t nChunk = n - done < chunk ? n - done : chunk;
+        fillArray(nChunk, arrayData, pArray);
+        sb_timer_t start = getCurrentNanoseconds();
+        runEngine(engine, engine.params, layout, pArray, nChunk, keyArray);
+        sb_timer_t sorted = getCurrentNanoseconds();
+        for(int64_t j=0; j<nChunk; j++) {
+            runWriterPut(&writer, pArray[j]->data);
+        }
+        times.sortNs += sorted - start;
+        times.runNs += getCurrentNanoseconds() - sorted;
+        runLengths.push_back(nChunk);
+    }
+    delete []arrayData;
+    delete []pArray;
+    delete []keyArray;
+    sb_timer_t start = getCurrentNanoseconds();
+    bOK = runWriterClose(&writer) && bOK;
+    times.runNs += getCurrentNanoseconds() - start;
+    times.nRuns = runLengths.size();
+
+    // Merge the runs.
+    start = getCurrentNanoseconds();
+    vector<RunReader> readers(runLengths.size());
+    vector<const char *> first(runLengths.size());
+    off_t runStart = 0;
+    for(size_t irun=0; irun<runLengths.size(); irun++) {
+        bOK = runReaderOpen(&readers[irun], fdRuns, runStart, runLengths[irun], sizeof(DataRecord),
+                            settings.extBufRecords) && bOK;
+        first[irun] = runReaderNext(&readers[irun]);
+        runStart += runLengths[irun] * sizeof(DataRecord);
+    }
+    LoserTree<SortKeyGreater> tree;
+    loserTreeInit(tree, first, SortKeyGreater());
+    runWriterOpen(&writer, fdOut, 0, sizeof(DataRecord), settings.extBufRecords);
+    DataRecord prev;
+    int64_t nOut = 0;
+    int irun;
+    while((irun = loserTreeWinner(tree)) >= 0) {
+        const char *record = tree.current[irun];
+        if(nOut > 0 && SortKeyGreater()(prev.data, record)) bOK = false;
+        memcpy(prev.data, record, sizeof(prev.data));
+        runWriterPut(&writer, record);
+        nOut++;
+        loserTreeReplaceWinner(tree, runReaderNext(&readers[irun]));
+    }
+    for(RunReader &reader : readers) {
+        bOK = runReaderClose(&reader) && bOK;
+    }
+    bOK = runWriterClose(&writer) && bOK;
+    times.mergeNs = getCurrentNanoseconds() - start;
+    if(nOut != n) bOK = false;
+
+    close(fdRuns);
+    close(fdOut);
+    unlink(runFileName.c_str());
+    unlink(outFileName.c_str());
+    return bOK;
+}
+
+void doExternalSorts(TypSettings settings, const vector<TypSortEngine> &engines)
+{
+    for(const TypSortEngine &engine : engines) {
+        for(TypLayout layout : settings.layouts) {
+            if(layout > LAYOUT_KEYPTR || !engineSupportsLayout(engine, layout)) {
+                printf("Sort engine %s does not support layout %s for external sort\n", engine.name.c_str(), nameOfLayout(layout));
+                continue;
+            }
+            printf("Using sort engine %s with layout %s for external sort\n", engine.name.c_str(), nameOfLayout(layout));
+            string logName = "Ext" + logNameOf(engine, layout);
+            const char *sortName = logName.c_str();
+            for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
+                for(int64_t add=0; add<2; add++) {
+                    int64_t n = nOrig + add;
+                    for(int loop=0; loop<settings.loopCt/2; loop++) {
+                        uint64_t seed = settings.seed + loop;
+                        setRandomSeed(seed);
+                        TypExtTimes times;
+                        bool bOK = doOneExternalSort(n, engine, layout, settings, times);
+                        sb_timer_t elapsedNs = times.sortNs + times.runNs + times.mergeNs;
+                        writeLogRec(sortName, n, seed, elapsedNs, bOK, nameOfDist(settings.dist), engine.params.nThreads);
+                        double elapsedSecs = 0.000000001 * elapsedNs;
+                        printf("%s size %lld seed %lld took %f sec for %.1f recs/sec; ret %s\n",
+                               sortName, n, seed, elapsedSecs, n / elapsedSecs, bOK ? "true":"false");
+                        printf("    %lld runs: sort %f sec, write runs %f sec, merge %f sec\n", times.nRuns,
+                               0.000000001 * times.sortNs, 0.000000001 * times.runNs, 0.000000001 * times.mergeNs);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//=====  Sorting an input file  ======================================
+
+// Sort the records of a mapped file.  inputOrder points to the records in
+// file order; pArray and keyArray must have room for n elements.
+// Exit:    pArray  points to the records in sorted order.
+bool doOneInputSort(const vector<ArrayElementType> &inputOrder, const TypSortEngine &engine,
+                    TypLayout layout, ArrayElementType *pArray, KeyPtrElement *keyArray,
+                    sb_timer_t &elapsedNs)
+{
+    int64_t n = inputOrder.size();
+    std::copy(inputOrder.begin(), inputOrder.end(), pArray);
+    uint64_t start = timerStart();
+    runEngine(engine, engine.params, layout, pArray, n, keyArray);
+    elapsedNs = timerElapsedNs(start);
+    return checkTopKOrder(pArray, n, engine.params.topK);
+}
+
+// Write records in sorted order to fileName.  Returns false on error.
+bool writeSortedFile(const InputFile &input, const ArrayElementType *pArray, int64_t n, const string &fileName)
+{
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return false;
+    bool bOK = inputFileWriteSorted(&input, pArray, n, fd);
+    return (0 == close(fd)) && bOK;
+}
+
+void doInputSorts(TypSettings settings, const vector<TypSortEngine> &engines)
+{
+    InputFile input;
+    if(!inputFileOpen(&input, settings.inFile.c_str(), settings.inFormat, sizeof(DataRecord))) {
+        printf("Cannot map %s\n", settings.inFile.c_str());
+        return;
+    }
+    vector<const char *> starts;
+    size_t nIgnored = inputFileRecords(&input, starts);
+    if(nIgnored > 0) {
+        printf("Ignoring a partial record of %zu bytes at the end of %s\n", nIgnored, settings.inFile.c_str());
+    }
+    // The pointers point straight into the mapping.
+    vector<ArrayElementType> inputOrder(starts.size());
+    for(size_t j=0; j<starts.size(); j++) {
+        inputOrder[j] = (ArrayElementType) starts[j];
+    }
+    int64_t n = inputOrder.size();
+    printf("Sorting %lld records from %s\n", n, settings.inFile.c_str());
+    ArrayElementType *pArray = new ArrayElementType[n];
+    KeyPtrElement *keyArray = new KeyPtrElement[n];
+    bool bWritten = settings.sortedFile.empty();
+    for(const TypSortEngine &engine : engines) {
+        for(TypLayout layout : settings.layouts) {
+            if(layout > LAYOUT_KEYPTR || !engineSupportsLayout(engine, layout)) {
+                printf("Sort engine %s does not support layout %s for input files\n", engine.name.c_str(), nameOfLayout(layout));
+                continue;
+            }
+            printf("Using sort engine %s with layout %s\n", engine.name.c_str(), nameOfLayout(layout));
+            string logName = logNameOf(engine, layout);
+            const char *sortName = logName.c_str();
+            for(int loop=0; loop<settings.loopCt; loop++) {
+                sb_timer_t elapsedNs;
+                bool bOK = doOneInputSort(inputOrder, engine, layout, pArray, keyArray, elapsedNs);
+                writeLogRec(sortName, n, 0, elapsedNs, bOK, "infile", engine.params.nThreads);
+                double elapsedSecs = 0.000000001 * elapsedNs;
+                printf("%s size %lld took %f sec for %.1f recs/sec; ret %s\n",
+                       sortName, n, elapsedSecs, n / elapsedSecs, bOK ? "true":"false");
+                if(!bWritten) {
+                    if(!writeSortedFile(input, pArray, n, settings.sortedFile)) {
+                        printf("Cannot write %s\n", settings.sortedFile.c_str());
+                    }
+                    bWritten = true;
+                }
+            }
+        }
+    }
+    delete []pArray;
+    delete []keyArray;
+    inputFileClose(&input);
+}
+
+//=====  Operation counting  ==========================================
+
+// Sort pArray with an engine's counting instantiation, setting the total
+// comparisons and moves.  For ShellSort, opPassCounts gets the counts for
+// each gap pass.  Copying the elements in and out is not counted.
+void runCountedEngine(const TypSortEngine &engine, const TypSortParams &params,
+                      ArrayElementType *pArray, int64_t n, int64_t &compares, int64_t &moves)
+{
+    vector<CountedElement> counted(pArray, pArray+n);
+    opCountsReset();
+    opPassCounts.clear();
+    engine.funcCounted(counted.data(), n, params);
+    compares = opCompares.load();
+    moves = opMoves.load();
+    for(int64_t j=0; j<n; j++) {
+        pArray[j] = counted[j];
+    }
+}
+
+void doCounts(TypSettings settings, const vector<TypSortEngine> &engines)
+{
+    FILE *fileCounts = fopen(settings.countFile.c_str(), "a");
+    if(NULL == fileCounts) {
+        printf("Cannot open %s\n", settings.countFile.c_str());
+        return;
+    }
+    for(const TypSortEngine &engine : engines) {
+        printf("Counting operations for sort engine %s\n", engine.name.c_str());
+        string logName = logNameOf(engine, LAYOUT_PTR);
+        const char *sortName = logName.c_str();
+        for(int64_t nOrig=settings.arraySizeMin; nOrig<=settings.arraySizeMax; nOrig*=settings.arraySizeMult) {
+            for(int64_t add=0; add<2; add++) {
+                int64_t n = nOrig + add;
+                for(int loop=0; loop<settings.loopCt/2; loop++) {
+                    uint64_t seed = settings.seed + loop;
+                    setRandomSeed(seed);
+                    DataRecord *arrayData;
+                    ArrayElementType * pArray = createArray(n, arrayData);
+                    int64_t compares, moves;
+                    runCountedEngine(engine, engine.params, pArray, n, compares, moves);
+                    bool bOK = checkTopKOrder(pArray, n, engine.params.topK);
+                    const char *szOK = bOK ? "true":"false";
+                    fprintf(fileCounts, "%s,%lld,%lld,total,%lld,%lld,%s\n", sortName, n, seed,
+                            compares, moves, szOK);
+                    for(const TypPassCounts &pass : opPassCounts) {
+                        fprintf(fileCounts, "%s,%lld,%lld,%lld,%lld,%lld,%s\n", sortName, n, seed,
+                                pass.gap, pass.compares, pass.moves, szOK);
+                    }
+                    double nLogN = n > 1 ? n * log2((double) n) : 1.0;
+                    printf("%s size %lld seed %lld: %lld compares (%.4f n log2 n), %lld moves; ret %s\n",
+                           sortName, n, seed, compares, compares/nLogN, moves, szOK);
+                    delete []arrayData;
+                    delete []pArray;
+                }
+            }
+        }
+    }
+    fclose(fileCounts);
+}
+
+//=====  Gap-sequence tuning  =========================================
+// -tune searches for the gap sequence that makes ShellSort fastest, or
+// compare least, on this machine at one size.  Every candidate starts
+// with Ciura's gaps; each gap after them is the one before times a
+// multiplier, then adjusted by a rule: left alone, made odd, or raised
+// until it is coprime to the gap before.  For each rule, the multiplier
+// is found by a pattern search: a spread of multipliers is scored, then
+// a spread half as wide around the best, and so on.  The candidates of a
+// round are timed concurrently, as cells on workers pinned to physical
+// cores, and logged like any other sort.
+
+enum TypGapRule {GAP_RULE_NONE, GAP_RULE_ODD, GAP_RULE_COPRIME, GAP_RULE_MAX};
+
+// allGaps[GAP_CIURA_22] starts with this many of Ciura's gaps.
+const int NUM_CIURA_GAPS = 8;
+// The first round scores TUNE_FIRST_POINTS multipliers from TUNE_MULT_MIN,
+// TUNE_MULT_STEP apart; later rounds score the best and two points either
+// side, with the step halved.
+const double TUNE_MULT_MIN = 1.75;
+const double TUNE_MULT_STEP = 0.125;
+const int TUNE_FIRST_POINTS = 9;
+const int TUNE_ROUNDS = 4;
+// Multipliers are kept within these, so that NUM_GAPS gaps fit in an int64_t.
+const double TUNE_MULT_LOW = 1.5;
+const double TUNE_MULT_HIGH = 3.5;
+
+const char *nameOfGapRule(TypGapRule rule)
+{
+    const char *names[GAP_RULE_MAX] = {"", "Odd", "Coprime"};
+    return rule < GAP_RULE_MAX ? names[rule] : "Unknown";
+}
+
+struct TypTuneCandidate {
+    double      multiplier = 0;
+    TypGapRule  rule = GAP_RULE_NONE;
+    int64_t     gaps[NUM_GAPS];
+    string      name;           // As nameOfGapType would give it, e.g. Tuned2281Odd.
+    double      value = 0;      // Median recs/sec, or mean compares / (n log2 n).
+    double      score = 0;      // Higher is better.
+    bool        bScored = false;
+};
+
+// Ciura's gaps, then NUM_GAPS-1-NUM_CIURA_GAPS more made by multiplier and rule.
+void buildTunedGaps(double multiplier, TypGapRule rule, int64_t gaps[NUM_GAPS])
+{
+    int j;
+    for(j=0; j<NUM_CIURA_GAPS; j++) {
+        gaps[j] = allGaps[GAP_CIURA_22][j];
+    }
+    for(; j<NUM_GAPS-1; j++) {
+        int64_t gap = (int64_t)(multiplier*gaps[j-1]);
+        if(GAP_RULE_ODD == rule) {
+            gap |= 1;
+        } else if(GAP_RULE_COPRIME == rule) {
+            while(1 != std::gcd(gap, gaps[j-1])) gap++;
+        }
+        gaps[j] = gap;
+    }
+    gaps[NUM_GAPS-1] = -1;
+}
+
+// The ShellSort engine for a candidate.
+TypSortEngine tuneEngineOf(TypTuneCandidate &cand)
+{
+    TypSortEngine engine = allEngines[GAP_CIURA_225_ODD];
+    engine.name = "ShellSort" + cand.name;
+    engine.params.gaps = cand.gaps;
+    // Candidates run on several workers at once, and passTimes is not shared.
+    engine.params.bTimePasses = false;
+    return engine;
+}
+
+// Time each candidate loopct/2 times at size n, on nJobs workers.
+// Returns false if any sort was wrong.
+bool scoreTuneByTime(const TypSettings &settings, int64_t n, int nJobs, const vector<TypTuneCandidate *> &cands)
+{
+    bool bOK = true;
+    vector<TypSortEngine> engines;
+    for(TypTuneCandidate *cand : cands) {
+        engines.push_back(tuneEngineOf(*cand));
+    }
+    TypCellQueue queue;
+    int runsPer = (int) std::max<int64_t>(1, settings.loopCt/2);
+    for(const TypSortEngine &engine : engines) {
+        for(int loop=0; loop<runsPer; loop++) {
+            TypCell cell;
+            cell.pEngine = &engine;
+            cell.layout = settings.layouts[0];
+            cell.recSize = settings.recordSizes[0];
+            cell.sortName = logNameOf(engine, cell.layout, cell.recSize);
+            cell.n = n;
+            cell.seed = settings.seed + loop;
+            queue.cells.push_back(cell);
+        }
+    }
+    size_t bytesArena = arenaBytesForSort(n, settings.layouts);
+    vector<std::thread> workers = startCellWorkers(settings, queue, nJobs, bytesArena);
+    vector<double> recsPerSec;
+    for(size_t j=0; j<queue.cells.size(); j++) {
+        TypCell &cell = queue.cells[j];
+        waitForCell(queue, cell);
+        reportSort(settings, *cell.pEngine, cell.sortName.c_str(), cell.n, cell.seed, cell.elapsedNs, cell.bOK, NULL);
+        if(!cell.bOK) bOK = false;
+        recsPerSec.push_back(n / (0.000000001 * cell.elapsedNs));
+        if(0 == (j+1) % runsPer) {
+            TypStats stats;
+            statsCompute(recsPerSec, stats);
+            TypTuneCandidate *cand = cands[j / runsPer];
+            cand->value = cand->score = stats.median;
+            cand->bScored = true;
+            recsPerSec.clear();
+        }
+    }
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+    return bOK;
+}
+
+// Count the comparisons of each candidate, loopct/2 times at size n.  The
+// counters are shared, so this runs on one thread.
+bool scoreTuneByCompares(const TypSettings &settings, int64_t n, const vector<TypTuneCandidate *> &cands)
+{
+    bool bOK = true;
+    int runsPer = (int) std::max<int64_t>(1, settings.loopCt/2);
+    for(TypTuneCandidate *cand : cands) {
+        TypSortEngine engine = tuneEngineOf(*cand);
+        int64_t totalCompares = 0;
+        for(int loop=0; loop<runsPer; loop++) {
+            setRandomSeed(settings.seed + loop);
+            DataRecord *arrayData;
+            ArrayElementType *pArray = createArray(n, arrayData);
+            int64_t compares, moves;
+            runCountedEngine(engine, engine.params, pArray, n, compares, moves);
+            if(!checkArrayOrder(pArray, n)) bOK = false;
+            totalCompares += compares;
+            delete []arrayData;
+            delete []pArray;
+        }
+        double nLogN = n > 1 ? n * log2((double) n) : 1.0;
+        cand->value = (double) totalCompares / runsPer / nLogN;
+        cand->score = -cand->value;
+        cand->bScored = true;
+    }
+    return bOK;
+}
+
+void printTuneCandidate(const TypTuneCandidate &cand, TypTuneScore score)
+{
+    if(TUNE_SCORE_TIME == score) {
+        printf("  %-22s multiplier %.5f: %.1f recs/sec\n", cand.name.c_str(), cand.multiplier, cand.value);
+    } else {
+        printf("  %-22s multiplier %.5f: %.5f compares / n log2 n\n", cand.name.c_str(), cand.multiplier, cand.value);
+    }
+}
+
+// The gaps of cand that a sort of n elements uses.
+vector<int64_t> tuneGapsUsed(const TypTuneCandidate &cand, int64_t n)
+{
+    vector<int64_t> used;
+    for(int j=0; cand.gaps[j]>0 && cand.gaps[j]<n; j++) {
+        used.push_back(cand.gaps[j]);
+    }
+    return used;
+}
+
+// Search for the best gap sequence at size sizemax.  winner is set to it.
+// Returns false if any sort was wrong.
+bool doTune(const TypSettings &settings, TypTuneCandidate &winner)
+{
+    bool bOK = true;
+    int64_t n = settings.arraySizeMax;
+    int nJobs = settings.nJobs;
+    if(nJobs <= 1) {
+        nJobs = std::max(1, (int) affinityPhysicalCores().size());
+    }
+    printf("Tuning gaps for %lld records by %s", n,
+           TUNE_SCORE_TIME == settings.tuneScore ? "recs/sec" : "comparisons");
+    if(TUNE_SCORE_TIME == settings.tuneScore) printf(", %d at a time", nJobs);
+    printf("\n");
+
+    // Candidates are kept in a deque, whose elements don't move, because
+    // engines point to their gaps.  Candidates that use the same gaps
+    // below n are sorted the same way, so each set is scored only once.
+    std::deque<TypTuneCandidate> all;
+    std::map<vector<int64_t>, TypTuneCandidate *> byGaps;
+    TypTuneCandidate *best[GAP_RULE_MAX] = {NULL};
+    double step = TUNE_MULT_STEP;
+    for(int round=0; round<TUNE_ROUNDS; round++) {
+        vector<TypTuneCandidate *> roundCands, toScore;
+        for(int irule=0; irule<GAP_RULE_MAX; irule++) {
+            TypGapRule rule = (TypGapRule) irule;
+            vector<double> multipliers;
+            if(0 == round) {
+                for(int k=0; k<TUNE_FIRST_POINTS; k++) multipliers.push_back(TUNE_MULT_MIN + k*TUNE_MULT_STEP);
+            } else {
+                for(int k=-2; k<=2; k++) multipliers.push_back(best[rule]->multiplier + k*step);
+            }
+            for(double multiplier : multipliers) {
+                if(multiplier < TUNE_MULT_LOW || multiplier > TUNE_MULT_HIGH) continue;
+                all.emplace_back();
+                TypTuneCandidate &cand = all.back();
+                cand.multiplier = multiplier;
+                cand.rule = rule;
+                buildTunedGaps(multiplier, rule, cand.gaps);
+                char name[40];
+                snprintf(name, sizeof(name), "Tuned%04d%s", (int) lround(1000*multiplier), nameOfGapRule(rule));
+                cand.name = name;
+                vector<int64_t> key = tuneGapsUsed(cand, n);
+                if(0 == byGaps.count(key)) {
+                    byGaps[key] = &cand;
+                    toScore.push_back(&cand);
+                }
+                roundCands.push_back(&cand);
+            }
+        }
+        if(TUNE_SCORE_TIME == settings.tuneScore) {
+            if(!scoreTuneByTime(settings, n, nJobs, toScore)) bOK = false;
+        } else {
+            if(!scoreTuneByCompares(settings, n, toScore)) bOK = false;
+        }
+        printf("Tuning round %d of %d:\n", round+1, TUNE_ROUNDS);
+        for(TypTuneCandidate *cand : roundCands) {
+            if(!cand->bScored) {
+                const TypTuneCandidate *same = byGaps[tuneGapsUsed(*cand, n)];
+                cand->value = same->value;
+                cand->score = same->score;
+                cand->bScored = true;
+            }
+            if(NULL == best[cand->rule] || cand->score > best[cand->rule]->score) {
+                best[cand->rule] = cand;
+            }
+        }
+        for(int irule=0; irule<GAP_RULE_MAX; irule++) {
+            printTuneCandidate(*best[irule], settings.tuneScore);
+        }
+        step /= 2;
+    }
+
+    // The first round includes multiplier 2.25 made odd, which is Ciura225Odd.
+    const TypTuneCandidate *pWinner = best[0];
+    for(int irule=1; irule<GAP_RULE_MAX; irule++) {
+        if(best[irule]->score > pWinner->score) pWinner = best[irule];
+    }
+    winner = *pWinner;
+    const TypTuneCandidate *baseline = NULL;
+    for(const TypTuneCandidate &cand : all) {
+        if(GAP_RULE_ODD == cand.rule && 2.25 == cand.multiplier) baseline = &cand;
+    }
+    printf("Best:\n");
+    printTuneCandidate(winner, settings.tuneScore);
+    if(NULL != baseline && 0 != baseline->value) {
+        printf("  %+.2f%% against Ciura225Odd\n", 100.0 * (winner.value - baseline->value) / baseline->value);
+    }
+
+    // Emit the sequence as it would be added to TypGap, nameOfGapType and allGaps.
+    string enumName = "GAP_TUNED_" + to_string(lround(1000*winner.multiplier));
+    if(GAP_RULE_NONE != winner.rule) {
+        string ruleName = nameOfGapRule(winner.rule);
+        std::transform(ruleName.begin(), ruleName.end(), ruleName.begin(), ::toupper);
+        enumName += "_" + ruleName;
+    }
+    printf("As a gap sequence entry:\n");
+    printf("    TypGap:        %s\n", enumName.c_str());
+    printf("    nameOfGapType: {%s, \"%s\"},\n", enumName.c_str(), winner.name.c_str());
+    printf("    allGaps:\n    {");
+    for(int j=0; j<NUM_GAPS; j++) {
+        if(j > 0) printf(0 == j % 10 ? ",\n        " : ", ");
+        printf("%lld", winner.gaps[j]);
+    }
+    printf("},\n");
+    return bOK;
+}
+
+//=====  Test functions  ==============================================
+
+void printArray(ArrayElementType * pArray, int64_t n)
+{
+    for(int irec=0; irec<n; irec++) {
+        printf("%3d: ", irec);
+        for(int ichar=0; ichar<sizeof(pArray[0]->data); ichar++) {
+            putchar(pArray[irec]->data[ichar]);
+        }
+        putchar('\n');
+    }
+}
+
+void testTimer()
+{
+    sb_timer_t start = getCurrentNanoseconds();
+    usleep(10000);
+    sb_timer_t stop = getCurrentNanoseconds();
+    sb_timer_t elapsed = stop - start;
+    printf("usleep(10000) gave elapsed %lld ns\n", elapsed);
+    start = getCurrentNanoseconds();
+    stop = getCurrentNanoseconds();
+    elapsed = stop - start;
+    printf("Two consec calls gave elapsed %lld ns\n", elapsed);
+
+    TypTimerSource saveSource = timer.source;
+    for(int isource=0; isource<TIMER_MAX; isource++) {
+        TypTimerSource source = (TypTimerSource) isource;
+        if(TIMER_TSC == source && !timerHaveInvariantTsc()) {
+            printf("Timer tsc: not invariant on this CPU\n");
+            continue;
+        }
+        timerInit(source);
+        TypTimerQuality quality;
+        timerMeasure(10000, quality);
+        printf("Timer %s: %.4f ns/tick, overhead %.1f ns (subtracted), resolution %.1f ns, "
+               "empty interval median %.1f ns, jitter %.1f ns\n", nameOfTimerSource(source), timer.nsPerTick,
+               quality.overheadNs, quality.resolutionNs, quality.medianNs, quality.jitterNs);
+        uint64_t begin = timerStart();
+        usleep(10000);
+        sb_timer_t elapsedNs = timerElapsedNs(begin);
+        if(elapsedNs < 10000000 || elapsedNs > 1000000000) {
+            printf("!! Timer %s gave %lld ns for usleep(10000)\n", nameOfTimerSource(source), elapsedNs);
+        }
+    }
+    timerInit(saveSource);
+}
+
+void testRNG()
+{
+    printf("Testing ability to reset PRNG:\n");
+    for(int loop=0; loop<3; loop++) {
+        setRandomSeed(762);
+        printf("Loop %d: ", loop);
+        for(int j=0; j<71; j++) {
+            putchar(getRandomChar());
+        }
+        putchar('\n');
+    }
+    setRandomSeed(762);
+    printf("Now let the PRNG generator run longer:\n");
+    for(int j=0; j<1000; j++) {
+        putchar(getRandomChar());
+    }
+    putchar('\n');
+}
+
+// Check that bulk, seeked and multi-threaded generation reproduce the
+// byte-at-a-time random stream exactly.
+void testBulkRNG()
+{
+    printf("Testing bulk and seekable random generation:\n");
+    bool bOK = true;
+    const int64_t seeds[] = {762, 301, 8803, -5};
+    const uint64_t nBytes = 5000;
+    const int laneCounts[] = {1, 4, 8, 16};
+    for(int lanes : laneCounts) {
+        if(!mySetRandomLanes(lanes)) {
+            printf("%d-lane MD5 is not supported on this CPU\n", lanes);
+            continue;
+        }
+        for(int64_t seed : seeds) {
+            unsigned char expected[nBytes], actual[nBytes];
+            setRandomSeed(seed);
+            for(uint64_t j=0; j<nBytes; j++) {
+                expected[j] = myNextRandomByte(&randomContext);
+            }
+            setRandomSeed(seed);
+            myRandomBytes(&randomContext, actual, 3);
+            myRandomBytes(&randomContext, actual+3, nBytes-3);
+            if(0 != memcmp(expected, actual, nBytes)) {
+                printf("!! %d-lane myRandomBytes differs from stream for seed %lld\n", lanes, seed);
+                bOK = false;
+            }
+            const uint64_t offsets[] = {0, 1, 15, 16, 17, 71*37+3, 4000};
+            for(uint64_t offset : offsets) {
+                mySeekRandom(&randomContext, offset);
+                if(myRandomPosition(&randomContext) != offset) {
+                    printf("!! myRandomPosition wrong after seek to %lld\n", offset);
+                    bOK = false;
+                }
+                myRandomBytes(&randomContext, actual, nBytes-offset);
+                if(0 != memcmp(expected+offset, actual, nBytes-offset)) {
+                    printf("!! %d-lane seek to %lld differs from stream for seed %lld\n", lanes, offset, seed);
+                    bOK = false;
+                }
+            }
+        }
+    }
+    mySetRandomLanes(0);
+
+    // Records generated with several threads must match getRandomChar().
+    const int64_t n = 4*MIN_RECORDS_PER_GEN_THREAD + 7;
+    setRandomSeed(301);
+    DataRecord *expectedData = new DataRecord[n];
+    for(int64_t j=0; j<n; j++) {
+        size_t ichar;
+        for(ichar=0; ichar<sizeof(expectedData[j].data)-1; ichar++) {
+            expectedData[j].data[ichar] = getRandomChar();
+        }
+        expectedData[j].data[ichar] = '\0';
+    }
+    int savedThreads = randomThreads;
+    const int threadCounts[] = {1, 3, 4};
+    for(int nThreads : threadCounts) {
+        setRandomThreads(nThreads);
+        setRandomSeed(301);
+        DataRecord *arrayData;
+        ArrayElementType *pArray = createArray(n, arrayData);
+        if(0 != memcmp(expectedData, arrayData, n*sizeof(DataRecord))) {
+            printf("!! createArray with %d threads differs from getRandomChar\n", nThreads);
+            bOK = false;
+        }
+        delete []arrayData;
+        delete []pArray;
+    }
+    setRandomThreads(savedThreads);
+    delete []expectedData;
+    if(bOK) {
+        printf("Bulk random generation OK\n");
+    }
+}
+
+void testOrder()
+{
+    DataRecord *arrayData;
+    int nElements = 3;
+    ArrayElementType * pArray = createArray(nElements, arrayData);
     pArray[0]->data[0] = 'a';
     pArray[1]->data[0] = 'b';
     pArray[2]->data[0] = 'c';
@@ -538,41 +3037,974 @@ void testOrder()
     delete []pArray;
 }
 
-void testGenArray()
+void testGenArray()
+{
+    int n = 8;
+    for(int loop=0; loop<5; loop++) {
+        uint64_t seed = 301 + loop;
+        setRandomSeed(seed);
+        DataRecord *arrayData;
+        ArrayElementType * pArray = createArray(n, arrayData);
+        printf("Generated array for seed %lld:\n", seed);
+        printArray(pArray, n);
+        delete []arrayData;
+        delete []pArray;
+    }
+}
+
+void testGenAndShellSort()
+{
+    int64_t n = 12;
+    printf("Testing generation and sorting of small array:\n");
+    setRandomSeed(5555);
+    DataRecord *arrayData;
+    ArrayElementType * pArray = createArray(n, arrayData);
+    printf("Generated array:\n");
+    printArray(pArray, n);
+    int64_t gaps[] = {1, 4, 10, 23, 57, 132, 301, 701, -1};
+    shellSort(pArray, n, gaps);
+    printf("Sorted array:\n");
+    printArray(pArray, n);
+    if(checkArrayOrder(pArray, n)) {
+        printf("Sorting is OK\n");
+    } else {
+        printf("!! Sorting is bad\n");
+    }
+    delete []arrayData;
+    delete []pArray;
+}
+
+// Sort one array of the given size and shape with an engine and layout.
+// Returns true if the result is in order.
+bool testOneEngineCase(const TypSortEngine &engine, TypLayout layout, int64_t n, int ishape)
+{
+    setRandomSeed(7000 + n);
+    DataRecord *arrayData;
+    ArrayElementType * pArray = createArray(n, arrayData);
+    KeyPtrElement *keyArray = new KeyPtrElement[n];
+    if(3 == ishape) {
+        for(int64_t j=0; j<n; j++) memcpy(pArray[j]->data, "aaaaaa", 6);
+    } else if(4 == ishape) {
+        for(int64_t j=0; j<n; j++) memset(pArray[j]->data, 'a' + (int)(j%3), 6);
+    } else if(5 == ishape) {
+        // Arbitrary bytes, including NULs and bytes above 0x7f.
+        for(int64_t j=0; j<n; j++) {
+            for(int k=0; k<6; k++) {
+                pArray[j]->data[k] = (char) ((j*2654435761u + k*40503u) >> (8+k));
+            }
+        }
+    } else if(0 != ishape) {
+        std::sort(pArray, pArray+n, LessFromGreater<ElementGreater>());
+        if(2 == ishape) std::reverse(pArray, pArray+n);
+    }
+    // Use several threads even on small machines, so the parallel code runs.
+    TypSortParams params = engine.params;
+    params.nThreads = 4;
+    runEngine(engine, params, layout, pArray, n, keyArray);
+    bool bOK = checkArrayOrder(pArray, n);
+    delete []arrayData;
+    delete []pArray;
+    delete []keyArray;
+    return bOK;
+}
+
+// Sort arrays of various sizes and shapes with every engine and layout.
+void testEngines()
 {
-    int n = 8;
-    for(int loop=0; loop<5; loop++) {
-        uint64_t seed = 301 + loop;
-        setRandomSeed(seed);
+    printf("Testing all sort engines:\n");
+    const int64_t sizes[] = {0, 1, 2, 3, 16, 17, 100, 129, 1000, 5000};
+    const char *shapes[] = {"random", "sorted", "reversed", "equal", "fewkeys", "bytes"};
+    for(const TypSortEngine &engine : allEngines) {
+        for(TypLayout layout=LAYOUT_PTR; layout<=LAYOUT_KEYPTR; layout=(TypLayout)(layout+1)) {
+            if(!engineSupportsLayout(engine, layout)) continue;
+            bool bAllOK = true;
+            for(int64_t n : sizes) {
+                for(int ishape=0; ishape<6; ishape++) {
+                    if(!testOneEngineCase(engine, layout, n, ishape)) {
+                        printf("!! %s failed on %s array of %lld\n",
+                               logNameOf(engine, layout).c_str(), shapes[ishape], n);
+                        bAllOK = false;
+                    }
+                }
+            }
+            if(bAllOK) {
+                printf("%s OK\n", logNameOf(engine, layout).c_str());
+            }
+        }
+    }
+}
+
+// Sort arrays big enough to be split among threads with ParMergeSort,
+// and check that the result is a permutation of the input in key order.
+void testParallelMergeSort()
+{
+    printf("Testing parallel merge sort:\n");
+    bool bOK = true;
+    vector<TypSortEngine> engines;
+    selectEngines("ParMergeSort", engines);
+    const int64_t sizes[] = {PAR_MERGE_SORT_LEAF + 1, 100000, 300001};
+    const int threadCounts[] = {1, 2, 3, 8};
+    for(int64_t n : sizes) {
+        for(int nThreads : threadCounts) {
+            for(TypLayout layout=LAYOUT_PTR; layout<=LAYOUT_KEYPTR; layout=(TypLayout)(layout+1)) {
+                setRandomSeed(9090 + n);
+                DataRecord *arrayData;
+                ArrayElementType *pArray = createArray(n, arrayData);
+                KeyPtrElement *keyArray = new KeyPtrElement[n];
+                TypSortParams params = engines[0].params;
+                params.nThreads = nThreads;
+                runEngine(engines[0], params, layout, pArray, n, keyArray);
+                bool bSame = checkArrayOrder(pArray, n);
+                std::sort(pArray, pArray+n);
+                for(int64_t j=0; bSame && j<n; j++) {
+                    bSame = pArray[j] == &arrayData[j];
+                }
+                if(!bSame) {
+                    printf("!! %s failed on %lld records with %d threads\n",
+                           logNameOf(engines[0], layout).c_str(), n, nThreads);
+                    bOK = false;
+                }
+                delete []arrayData;
+                delete []pArray;
+                delete []keyArray;
+            }
+        }
+    }
+    if(bOK) {
+        printf("Parallel merge sort OK\n");
+    }
+}
+
+// The counts of threads a sort starts must not carry over into later
+// regions: sorting the same records again and again should count about the
+// same each time, not more with each sort.
+void testPerfCounters()
+{
+    printf("Testing performance counters:\n");
+    PerfCounterSet perfSet;
+    if(!perfOpen(&perfSet)) {
+        printf("Hardware performance counters are not available; not tested\n");
+        return;
+    }
+    bool bOK = true;
+    vector<TypSortEngine> engines;
+    selectEngines("ParShellSortCiura225Odd", engines);
+    TypSortParams params = engines[0].params;
+    params.nThreads = 4;
+    const int64_t n = 200000;
+    const int nRuns = 5;
+    int64_t instructions[nRuns];
+    for(int run=0; run<nRuns; run++) {
+        setRandomSeed(7070);
         DataRecord *arrayData;
-        ArrayElementType * pArray = createArray(n, arrayData);
-        printf("Generated array for seed %lld:\n", seed);
-        printArray(pArray, n);
+        ArrayElementType *pArray = createArray(n, arrayData);
+        TypPerfCounts perfCounts;
+        perfStart(&perfSet);
+        runEngine(engines[0], params, LAYOUT_PTR, pArray, n, NULL);
+        perfStop(&perfSet, &perfCounts);
+        instructions[run] = perfCounts.counts[PERF_INSTRUCTIONS];
         delete []arrayData;
         delete []pArray;
     }
+    perfClose(&perfSet);
+    if(instructions[nRuns-1] > instructions[0] + instructions[0]/2) {
+        printf("!! %s counted %lld instructions the first time and %lld the last\n",
+               engines[0].name.c_str(), instructions[0], instructions[nRuns-1]);
+        bOK = false;
+    }
+    if(bOK) {
+        printf("Performance counters OK\n");
+    }
 }
 
-void testGenAndShellSort()
+// Check the counting build: every engine must still sort, and Shellsort
+// on sorted input must do exactly one comparison and two moves per element
+// per pass.
+void testOpCounts()
 {
-    int64_t n = 12;
-    printf("Testing generation and sorting of small array:\n");
-    setRandomSeed(5555);
+    printf("Testing operation counting:\n");
+    bool bOK = true;
+    const int64_t n = 1000;
+    for(const TypSortEngine &engine : allEngines) {
+        setRandomSeed(4321);
+        DataRecord *arrayData;
+        ArrayElementType * pArray = createArray(n, arrayData);
+        int64_t compares, moves;
+        runCountedEngine(engine, engine.params, pArray, n, compares, moves);
+        if(!checkArrayOrder(pArray, n) || moves <= 0) {
+            printf("!! Counted %s failed: sorted %s, %lld moves\n", engine.name.c_str(),
+                   checkArrayOrder(pArray, n) ? "true":"false", moves);
+            bOK = false;
+        }
+        delete []arrayData;
+        delete []pArray;
+    }
+
+    setRandomSeed(4321);
     DataRecord *arrayData;
     ArrayElementType * pArray = createArray(n, arrayData);
-    printf("Generated array:\n");
-    printArray(pArray, n);
-    int64_t gaps[] = {1, 4, 10, 23, 57, 132, 301, 701, -1};
-    shellSort(pArray, n, gaps);
-    printf("Sorted array:\n");
-    printArray(pArray, n);
-    if(checkArrayOrder(pArray, n)) {
-        printf("Sorting is OK\n");
-    } else {
-        printf("!! Sorting is bad\n");
+    std::sort(pArray, pArray+n, LessFromGreater<ElementGreater>());
+    const TypSortEngine &engine = allEngines[GAP_CIURA_225_ODD];
+    int64_t compares, moves, expected = 0;
+    runCountedEngine(engine, engine.params, pArray, n, compares, moves);
+    for(const TypPassCounts &pass : opPassCounts) {
+        expected += n - pass.gap;
+        if(pass.compares != n - pass.gap || pass.moves != 2*(n - pass.gap)) {
+            printf("!! Gap %lld pass: %lld compares, %lld moves; expected %lld, %lld\n",
+                   pass.gap, pass.compares, pass.moves, n - pass.gap, 2*(n - pass.gap));
+            bOK = false;
+        }
+    }
+    if(opPassCounts.empty() || compares != expected || moves != 2*expected) {
+        printf("!! %s on sorted input: %lld compares, %lld moves; expected %lld, %lld\n",
+               engine.name.c_str(), compares, moves, expected, 2*expected);
+        bOK = false;
+    }
+    delete []arrayData;
+    delete []pArray;
+    if(bOK) {
+        printf("Operation counting OK\n");
+    }
+}
+
+// Check the arena, and that sorts whose arrays come from it are correct
+// when the memory is reused.
+void testArena()
+{
+    printf("Testing arena:\n");
+    bool bOK = true;
+    const int64_t n = 5000;
+    Arena arena;
+    if(!arenaInit(&arena, arenaBytesForSort(n, {LAYOUT_PTR, LAYOUT_KEYPTR}), HUGEPAGES_THP, true)) {
+        printf("!! arenaInit failed\n");
+        return;
+    }
+    printf("Arena of %zu bytes with pages %s\n", arena.capacity, nameOfHugePages(arena.pages));
+    char *p1 = (char *) arenaAlloc(&arena, 3);
+    char *p2 = (char *) arenaAlloc(&arena, 100);
+    if(p1 != arena.base || p2 != p1 + ARENA_ALIGN || NULL != arenaAlloc(&arena, arena.capacity)) {
+        printf("!! arenaAlloc returned %p, %p for base %p\n", p1, p2, arena.base);
+        bOK = false;
+    }
+    for(int ilayout=0; ilayout<LAYOUT_MAX; ilayout++) {
+        for(uint64_t seed=1; seed<=3; seed++) {
+            sb_timer_t elapsedNs;
+            TypPerfCounts perfCounts;
+            setRandomSeed(seed);
+            if(!doOneSort(n, allEngines[GAP_CIURA_225_ODD], (TypLayout) ilayout, sizeof(DataRecord), &arena,
+                          elapsedNs, NULL, perfCounts)) {
+                printf("!! Sort in arena failed for layout %s seed %lld\n",
+                       nameOfLayout((TypLayout) ilayout), seed);
+                bOK = false;
+            }
+        }
+    }
+    arenaFree(&arena);
+    if(bOK) {
+        printf("Arena OK\n");
+    }
+}
+
+// Check that datasets read from the cache match freshly generated ones.
+void testDatasetCache()
+{
+    printf("Testing dataset cache:\n");
+    char cacheDir[] = "/tmp/sortbench-cache-XXXXXX";
+    if(NULL == mkdtemp(cacheDir)) {
+        printf("!! Cannot create %s\n", cacheDir);
+        return;
+    }
+    bool bOK = true;
+    const int64_t n = 20000;
+    DataRecord *expectedData, *arrayData;
+    setRandomSeed(999);
+    ArrayElementType *pExpected = createArray(n, expectedData);
+    setDatasetCache(cacheDir);
+    // The first pass writes the file; the second reads it.
+    for(int pass=0; pass<2; pass++) {
+        setRandomSeed(999);
+        ArrayElementType *pArray = createArray(n, arrayData);
+        if(0 != memcmp(arrayData, expectedData, n*sizeof(DataRecord))) {
+            printf("!! Pass %d: cached dataset differs from generated one\n", pass);
+            bOK = false;
+        }
+        delete []arrayData;
+        delete []pArray;
+    }
+    setDatasetCache("");
+    string fileName = datasetFileName(cacheDir, 999, n);
+    if(0 != unlink(fileName.c_str())) {
+        printf("!! %s was not created\n", fileName.c_str());
+        bOK = false;
+    }
+    rmdir(cacheDir);
+    delete []expectedData;
+    delete []pExpected;
+    if(bOK) {
+        printf("Dataset cache OK\n");
+    }
+}
+
+// Run a sweep with driver and return the lines it logged, less the timing columns.
+vector<string> runSweepForTest(const char *dir, const TypSettings &settings, const vector<TypSortEngine> &engines,
+                               void (*driver)(const TypSettings &, const vector<TypSortEngine> &))
+{
+    vector<string> results;
+    string fileName = string(dir) + "/sweep.csv";
+    openLogFile(fileName.c_str());
+    driver(settings, engines);
+    closeLogFile();
+    FILE *file = fopen(fileName.c_str(), "r");
+    char line[1024];
+    while(NULL != fgets(line, sizeof(line), file)) {
+        string rec;
+        int ifield = 0;
+        for(const char *pch=line; '\0' != *pch && '\n' != *pch; pch++) {
+            if(',' == *pch) ifield++;
+            if(3 != ifield && 4 != ifield) rec += *pch;
+        }
+        results.push_back(rec);
+    }
+    fclose(file);
+    unlink(fileName.c_str());
+    return results;
+}
+
+// Run the same small sweep with doSorts and with the pipelined and
+// concurrent drivers, and check that they log the same sorts, in the
+// same order, all sorted correctly.
+void testDrivers()
+{
+    printf("Testing the pipelined and concurrent drivers:\n");
+    char dir[] = "/tmp/sortbench-drv-XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        printf("!! Cannot create %s\n", dir);
+        return;
+    }
+    bool bOK = true;
+    TypSettings settings;
+    settings.arraySizeMin = 1000;
+    settings.arraySizeMax = 100000;
+    settings.loopCt = 4;
+    settings.layouts = {LAYOUT_PTR, LAYOUT_KEYPTR};
+    vector<TypSortEngine> engines;
+    selectEngines("ShellSortCiura225Odd,StdSort", engines);
+    auto sequential = [](const TypSettings &settings, const vector<TypSortEngine> &engines) {
+        doSorts(settings, engines);
+    };
+    vector<string> expected = runSweepForTest(dir, settings, engines, sequential);
+    for(const string &rec : expected) {
+        if(string::npos == rec.find(",true,")) bOK = false;
+    }
+    if(expected.empty() || runSweepForTest(dir, settings, engines, doPipelinedSorts) != expected) {
+        printf("!! Pipelined driver logged different sorts than doSorts\n");
+        bOK = false;
+    }
+    settings.nJobs = 3;
+    if(runSweepForTest(dir, settings, engines, doJobSorts) != expected) {
+        printf("!! Concurrent driver logged different sorts than doSorts\n");
+        bOK = false;
+    }
+    // Records of another size, generated through createSizedRecords.
+    settings.nJobs = 1;
+    settings.layouts = {LAYOUT_RECORDS};
+    settings.recordSizes = {256};
+    settings.arraySizeMax = 10000;
+    expected = runSweepForTest(dir, settings, engines, sequential);
+    settings.nJobs = 4;
+    if(expected.empty() || runSweepForTest(dir, settings, engines, doJobSorts) != expected) {
+        printf("!! Concurrent driver logged different record sorts than doSorts\n");
+        bOK = false;
+    }
+    rmdir(dir);
+    if(bOK) {
+        printf("Pipelined and concurrent drivers OK\n");
+    }
+}
+
+// Check the external sort, including a single run and a final short run.
+void testExternalSort()
+{
+    printf("Testing external sort:\n");
+    char extDir[] = "/tmp/sortbench-ext-XXXXXX";
+    if(NULL == mkdtemp(extDir)) {
+        printf("!! Cannot create %s\n", extDir);
+        return;
+    }
+    bool bOK = true;
+    TypSettings settings;
+    settings.extDir = extDir;
+    settings.extBufRecords = 100;
+    const int64_t chunks[] = {7000, 50000, 1};
+    for(int64_t chunk : chunks) {
+        int64_t n = 1 == chunk ? 300 : 50000;
+        settings.extChunk = chunk;
+        for(int ilayout=0; ilayout<=LAYOUT_KEYPTR; ilayout++) {
+            TypExtTimes times;
+            setRandomSeed(8080);
+            if(!doOneExternalSort(n, allEngines[GAP_CIURA_225_ODD], (TypLayout) ilayout, settings, times)) {
+                printf("!! External sort of %lld in chunks of %lld failed for layout %s\n",
+                       n, chunk, nameOfLayout((TypLayout) ilayout));
+                bOK = false;
+            }
+        }
+    }
+    rmdir(extDir);
+    if(bOK) {
+        printf("External sort OK\n");
+    }
+}
+
+// Write a file, sort it through the mapping and check the sorted file.
+bool testOneInputFile(const char *dir, TypInFormat format, const string &contents,
+                      vector<string> expected)
+{
+    string fileName = string(dir) + "/in.dat", sortedName = string(dir) + "/sorted.dat";
+    FILE *file = fopen(fileName.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+
+    bool bOK = false;
+    InputFile input;
+    if(inputFileOpen(&input, fileName.c_str(), format, sizeof(DataRecord))) {
+        vector<const char *> starts;
+        inputFileRecords(&input, starts);
+        vector<ArrayElementType> inputOrder;
+        for(const char *start : starts) {
+            inputOrder.push_back((ArrayElementType) start);
+        }
+        int64_t n = inputOrder.size();
+        ArrayElementType *pArray = new ArrayElementType[n];
+        KeyPtrElement *keyArray = new KeyPtrElement[n];
+        sb_timer_t elapsedNs;
+        bOK = n == (int64_t) expected.size() &&
+            doOneInputSort(inputOrder, allEngines[GAP_CIURA_225_ODD], LAYOUT_KEYPTR, pArray, keyArray, elapsedNs) &&
+            writeSortedFile(input, pArray, n, sortedName);
+        delete []pArray;
+        delete []keyArray;
+        inputFileClose(&input);
+    }
+    if(bOK) {
+        // The sorted file must hold the same records, in key order.
+        std::stable_sort(expected.begin(), expected.end(), [](const string &first, const string &second) {
+            return strncmp(first.c_str(), second.c_str(), sortKey.len) < 0;
+        });
+        string sorted;
+        for(const string &rec : expected) {
+            sorted += rec;
+        }
+        FILE *fileSorted = fopen(sortedName.c_str(), "rb");
+        string actual(sorted.size() + 1, '\0');
+        actual.resize(fread(&actual[0], 1, actual.size(), fileSorted));
+        fclose(fileSorted);
+        // Records with equal keys may be in any order, so compare keys only.
+        bOK = actual.size() == sorted.size();
+        for(size_t pos=0; bOK && pos<actual.size(); ) {
+            size_t len = INFORMAT_LINES == format ? actual.find('\n', pos) + 1 - pos : sizeof(DataRecord);
+            bOK = 0 == strncmp(&actual[pos], &sorted[pos], std::min<size_t>(len, sortKey.len));
+            pos += len;
+        }
+    }
+    unlink(fileName.c_str());
+    unlink(sortedName.c_str());
+    return bOK;
+}
+
+void testInputFile()
+{
+    printf("Testing input files:\n");
+    char dir[] = "/tmp/sortbench-in-XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        printf("!! Cannot create %s\n", dir);
+        return;
+    }
+    bool bOK = true;
+    const int64_t n = 3000;
+    DataRecord *arrayData;
+    setRandomSeed(2024);
+    ArrayElementType *pArray = createArray(n, arrayData);
+    string contents((const char *) arrayData, n*sizeof(DataRecord));
+    vector<string> expected;
+    for(int64_t j=0; j<n; j++) {
+        expected.push_back(string(arrayData[j].data, sizeof(DataRecord)));
+    }
+    if(!testOneInputFile(dir, INFORMAT_RECORDS, contents, expected)) {
+        printf("!! Sorting a file of records failed\n");
+        bOK = false;
+    }
+    // Lines of many lengths, including empty and short ones; the last has no newline.
+    expected.clear();
+    contents.clear();
+    for(int64_t j=0; j<n; j++) {
+        string line = string(arrayData[j].data, j % 11) + "\n";
+        expected.push_back(line);
+        contents += line;
+    }
+    expected.push_back("abc\n");
+    contents += "abc";
+    if(!testOneInputFile(dir, INFORMAT_LINES, contents, expected)) {
+        printf("!! Sorting a file of lines failed\n");
+        bOK = false;
+    }
+    delete []arrayData;
+    delete []pArray;
+    rmdir(dir);
+    if(bOK) {
+        printf("Input files OK\n");
+    }
+}
+
+// Returns the number of places where a record's key is less than the
+// previous record's.
+int64_t countDescents(const DataRecord *arrayData, int64_t n)
+{
+    int64_t nDescents = 0;
+    for(int64_t j=1; j<n; j++) {
+        if(recordLess(arrayData[j], arrayData[j-1])) nDescents++;
+    }
+    return nDescents;
+}
+
+// Check that each distribution has its shape, is reproducible, and is
+// sorted correctly.
+void testDistributions()
+{
+    printf("Testing distributions:\n");
+    bool bOK = true;
+    const int64_t n = 10000;
+    for(int idist=0; idist<DIST_MAX; idist++) {
+        TypDist dist = (TypDist) idist;
+        setInputDist(dist);
+        DataRecord *arrayData, *arrayData2;
+        setRandomSeed(555);
+        ArrayElementType *pArray = createArray(n, arrayData);
+        setRandomSeed(555);
+        ArrayElementType *pArray2 = createArray(n, arrayData2);
+        bool bSame = 0 == memcmp(arrayData, arrayData2, n*sizeof(DataRecord));
+
+        int64_t nDescents = countDescents(arrayData, n);
+        vector<string> keys;
+        for(int64_t j=0; j<n; j++) {
+            keys.push_back(string(arrayData[j].data + sortKey.off, sortKey.len));
+        }
+        std::sort(keys.begin(), keys.end());
+        int64_t nUnique = std::unique(keys.begin(), keys.end()) - keys.begin();
+        bool bShape = true;
+        switch(dist) {
+            case DIST_SORTED:           bShape = 0 == nDescents; break;
+            case DIST_REVERSED:         bShape = nDescents > n*9/10; break;
+            case DIST_NEARLY_SORTED:    bShape = nDescents > 0 && nDescents <= 4*(n/100); break;
+            case DIST_FEW_UNIQUE:       bShape = nUnique <= 16; break;
+            case DIST_ORGAN_PIPE:       bShape = 0 == countDescents(arrayData, n/2) && nDescents > n*4/10; break;
+            case DIST_ZIPF:             bShape = nUnique < n/2; break;
+            case DIST_SORTED_RUNS:      bShape = nDescents <= 100 + 4*(n/100); break;
+            default:                    bShape = nDescents > n*4/10; break;
+        }
+        if(!bSame || !bShape) {
+            printf("!! Distribution %s: reproducible %s, %lld descents, %lld unique keys\n",
+                   nameOfDist(dist), bSame ? "true":"false", nDescents, nUnique);
+            bOK = false;
+        }
+        runEngine(allEngines[GAP_CIURA_225_ODD], allEngines[GAP_CIURA_225_ODD].params, LAYOUT_PTR, pArray, n, NULL);
+        if(!checkArrayOrder(pArray, n)) {
+            printf("!! Distribution %s was not sorted\n", nameOfDist(dist));
+            bOK = false;
+        }
+        delete []arrayData;
+        delete []pArray;
+        delete []arrayData2;
+        delete []pArray2;
+    }
+    setInputDist(DIST_UNIFORM);
+    if(bOK) {
+        printf("Distributions OK\n");
+    }
+}
+
+// Sort records of fixed-size and runtime sizes in every layout.
+void testRecordSizes()
+{
+    printf("Testing record sizes:\n");
+    bool bOK = true;
+    const size_t recSizes[] = {8, 16, 24, 72, 100, 256, 4096};
+    const int64_t sizes[] = {0, 1, 17, 1000};
+    const TypSortEngine *engines[] = {&allEngines[GAP_CIURA_225_ODD], &allEngines[GAP_MAX + GAP_CIURA_225_ODD]};
+    for(const TypSortEngine *pEngine : engines) {
+        for(int ilayout=0; ilayout<LAYOUT_MAX; ilayout++) {
+            TypLayout layout = (TypLayout) ilayout;
+            if(!engineSupportsLayout(*pEngine, layout)) continue;
+            for(size_t recSize : recSizes) {
+                for(int64_t n : sizes) {
+                    sb_timer_t elapsedNs;
+                    TypPerfCounts perfCounts;
+                    setRandomSeed(6060 + n);
+                    if(!doOneSort(n, *pEngine, layout, recSize, NULL, elapsedNs, NULL, perfCounts)) {
+                        printf("!! %s failed on %lld records\n", logNameOf(*pEngine, layout, recSize).c_str(), n);
+                        bOK = false;
+                    }
+                }
+            }
+        }
+    }
+    if(bOK) {
+        printf("Record sizes OK\n");
+    }
+}
+
+// Check keyGreater against memcmp for every key offset and length, then
+// sort with a few keys.
+void testKeyCompare()
+{
+    printf("Testing key comparison:\n");
+    bool bOK = true;
+    const int nRecs = 64;
+    DataRecord recs[nRecs];
+    setRandomSeed(7070);
+    for(int j=0; j<nRecs; j++) {
+        for(size_t ichar=0; ichar<sizeof(recs[j].data); ichar++) {
+            recs[j].data[ichar] = (char) randomBelow(256);
+        }
+    }
+    for(int off=0; off<KEY_END_MAX && bOK; off++) {
+        for(int len=1; off+len<=KEY_END_MAX && bOK; len++) {
+            KeySpec spec;
+            keySpecInit(spec, off, len);
+            for(int j=0; j<nRecs; j++) {
+                DataRecord first = recs[j], second = recs[(j+1) % nRecs];
+                // Make the keys agree up to a random byte, so that each byte
+                // position gets to decide some comparisons.
+                memcpy(second.data + off, first.data + off, randomBelow(len+1));
+                int cmp = memcmp(first.data + off, second.data + off, len);
+                int cmpPrefix = memcmp(first.data + off, second.data + off, std::min(len, KEY_WORD_LEN));
+                uint64_t prefixFirst = keyPrefixWord(spec, first.data), prefixSecond = keyPrefixWord(spec, second.data);
+                if(keyGreater(spec, first.data, second.data) != (cmp > 0) ||
+                   keyGreater(spec, second.data, first.data) != (cmp < 0) ||
+                   (prefixFirst > prefixSecond) != (cmpPrefix > 0) ||
+                   (prefixFirst < prefixSecond) != (cmpPrefix < 0)) {
+                    printf("!! Key at %d of length %d compared wrongly\n", off, len);
+                    bOK = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    KeySpec saveKey = sortKey;
+    const int keys[][2] = {{0, 6}, {3, 8}, {10, 12}, {5, 30}, {40, 31}, {0, 71}};
+    for(const int *key : keys) {
+        keySpecInit(sortKey, key[0], key[1]);
+        for(const TypSortEngine &engine : allEngines) {
+            for(int ilayout=0; ilayout<LAYOUT_MAX; ilayout++) {
+                TypLayout layout = (TypLayout) ilayout;
+                if(!engineSupportsLayout(engine, layout)) continue;
+                sb_timer_t elapsedNs;
+                TypPerfCounts perfCounts;
+                setRandomSeed(7171);
+                if(!doOneSort(3000, engine, layout, sizeof(DataRecord), NULL, elapsedNs, NULL, perfCounts)) {
+                    printf("!! %s failed\n", logNameOf(engine, layout).c_str());
+                    bOK = false;
+                }
+            }
+        }
+    }
+    sortKey = saveKey;
+    if(bOK) {
+        printf("Key comparison OK\n");
+    }
+}
+
+void testStats()
+{
+    printf("Testing run statistics:\n");
+    bool bOK = true;
+    // One run far slower than the rest, which must be rejected.
+    vector<double> samples = {13, 100, 11, 15, 17, 10, 12, 14, 16, 18};
+    TypStats stats;
+    statsCompute(samples, stats);
+    if(10 != stats.nRuns || 1 != stats.nRejected || 14 != stats.median || 14 != stats.mean ||
+       14 != stats.trimmedMean || fabs(stats.mad - 2*1.4826) > 1e-9) {
+        printf("!! Stats wrong: runs %lld rejected %lld median %f MAD %f mean %f trimmed mean %f\n",
+               stats.nRuns, stats.nRejected, stats.median, stats.mad, stats.mean, stats.trimmedMean);
+        bOK = false;
+    }
+    if(!(stats.ciLow < stats.median && stats.median < stats.ciHigh && stats.ciLow >= 10 && stats.ciHigh <= 18)) {
+        printf("!! Confidence interval %f to %f is wrong for median %f\n", stats.ciLow, stats.ciHigh, stats.median);
+        bOK = false;
+    }
+    TypStats again;
+    statsCompute(samples, again);
+    if(again.ciLow != stats.ciLow || again.ciHigh != stats.ciHigh) {
+        printf("!! Confidence interval differs between identical calls\n");
+        bOK = false;
+    }
+    // Mostly identical runs: the MAD is 0, and nothing is rejected.
+    statsCompute({5, 5, 5, 7}, stats);
+    if(0 != stats.nRejected || 5 != stats.median || 0 != stats.mad || 5 != stats.ciLow || stats.ciHigh > 7) {
+        printf("!! Stats of mostly identical runs wrong\n");
+        bOK = false;
+    }
+
+    // With a target every cell meets, each size stops after minloops runs,
+    // and -stats writes one summary per size.
+    char dir[] = "/tmp/sortbench-stats-XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        printf("!! Cannot create %s\n", dir);
+        return;
+    }
+    TypSettings settings;
+    settings.arraySizeMin = settings.arraySizeMax = 1000;
+    settings.loopCt = 40;
+    settings.warmup = 2;
+    settings.ciTarget = 1000;
+    settings.minLoops = 3;
+    vector<TypSortEngine> engines;
+    selectEngines("ShellSortCiura225Odd", engines);
+    string statsName = string(dir) + "/stats.csv";
+    openStatsFile(statsName.c_str());
+    auto adaptive = [](const TypSettings &settings, const vector<TypSortEngine> &engines) {
+        doSorts(settings, engines);
+    };
+    vector<string> runs = runSweepForTest(dir, settings, engines, adaptive);
+    closeStatsFile();
+    if(6 != runs.size()) {
+        printf("!! Adaptive sweep ran %d sorts instead of 6\n", (int) runs.size());
+        bOK = false;
+    }
+    FILE *file = fopen(statsName.c_str(), "r");
+    char line[1024];
+    int nLines = 0;
+    while(NULL != file && NULL != fgets(line, sizeof(line), file)) {
+        const char *expected[] = {"ShellSortCiura225Odd,1000,uniform,1,3,", "ShellSortCiura225Odd,1001,uniform,1,3,"};
+        if(nLines >= 2 || 0 != strncmp(line, expected[nLines], strlen(expected[nLines]))) {
+            printf("!! Unexpected stats line: %s", line);
+            bOK = false;
+        }
+        nLines++;
+    }
+    if(NULL != file) fclose(file);
+    if(2 != nLines) {
+        printf("!! Stats file has %d lines instead of 2\n", nLines);
+        bOK = false;
+    }
+    unlink(statsName.c_str());
+    rmdir(dir);
+    if(bOK) {
+        printf("Run statistics OK\n");
+    }
+}
+
+void testTune()
+{
+    printf("Testing gap tuning:\n");
+    bool bOK = true;
+    int64_t gaps[NUM_GAPS];
+    buildTunedGaps(2.25, GAP_RULE_ODD, gaps);
+    if(!std::equal(gaps, gaps+NUM_GAPS, allGaps[GAP_CIURA_225_ODD])) {
+        printf("!! Tuned gaps for 2.25 odd differ from Ciura225Odd\n");
+        bOK = false;
+    }
+    buildTunedGaps(2.5, GAP_RULE_COPRIME, gaps);
+    for(int j=1; j<NUM_GAPS-1; j++) {
+        if(gaps[j] <= gaps[j-1] || (j >= NUM_CIURA_GAPS && 1 != std::gcd(gaps[j], gaps[j-1]))) {
+            printf("!! Coprime gap %lld follows %lld\n", gaps[j], gaps[j-1]);
+            bOK = false;
+        }
+    }
+
+    // Counting comparisons is deterministic, and the winner can't compare
+    // more than Ciura225Odd, which is among the candidates.
+    TypSettings settings;
+    settings.arraySizeMax = 2000;
+    settings.loopCt = 2;
+    settings.tuneScore = TUNE_SCORE_COMPARES;
+    TypTuneCandidate winner, again;
+    if(!doTune(settings, winner) || !doTune(settings, again)) {
+        printf("!! Tuning sorted wrongly\n");
+        bOK = false;
+    }
+    if(winner.name != again.name || winner.value != again.value) {
+        printf("!! Tuning by comparisons gave %s then %s\n", winner.name.c_str(), again.name.c_str());
+        bOK = false;
+    }
+    TypTuneCandidate baseline;
+    buildTunedGaps(2.25, GAP_RULE_ODD, baseline.gaps);
+    vector<TypTuneCandidate *> cands = {&baseline};
+    scoreTuneByCompares(settings, settings.arraySizeMax, cands);
+    if(winner.value > baseline.value) {
+        printf("!! Tuned gaps compare more than Ciura225Odd: %f > %f\n", winner.value, baseline.value);
+        bOK = false;
+    }
+
+    // Timed, on two workers; the sorts are logged.
+    char dir[] = "/tmp/sortbench-tune-XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        printf("!! Cannot create %s\n", dir);
+        return;
+    }
+    settings.tuneScore = TUNE_SCORE_TIME;
+    settings.nJobs = 2;
+    auto tune = [](const TypSettings &settings, const vector<TypSortEngine> &engines) {
+        TypTuneCandidate winner;
+        if(!doTune(settings, winner)) {
+            printf("!! Timed tuning sorted wrongly\n");
+        }
+    };
+    vector<string> runs = runSweepForTest(dir, settings, vector<TypSortEngine>(), tune);
+    rmdir(dir);
+    if(runs.empty() || 0 != runs[0].find("ShellSortTuned1750,2000,")) {
+        printf("!! Timed tuning logged %s\n", runs.empty() ? "nothing" : runs[0].c_str());
+        bOK = false;
+    }
+    for(const string &rec : runs) {
+        if(string::npos == rec.find(",true,")) bOK = false;
+    }
+    if(bOK) {
+        printf("Gap tuning OK\n");
+    }
+}
+
+// Time the passes of a small sweep, and check that each sort logged one
+// line for each gap below n, largest first.
+void testPassTiming()
+{
+    printf("Testing per-pass timing:\n");
+    bool bOK = true;
+    char dir[] = "/tmp/sortbench-pass-XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        printf("!! Cannot create %s\n", dir);
+        return;
+    }
+    TypSettings settings;
+    settings.arraySizeMin = 1000;
+    settings.arraySizeMax = 10000;
+    settings.loopCt = 2;
+    settings.layouts = {LAYOUT_PTR, LAYOUT_KEYPTR};
+    settings.bPasses = true;
+    settings.passFile = string(dir) + "/passes.csv";
+    vector<TypSortEngine> engines;
+    selectEngines("ShellSortLee21", engines);
+    engines[0].params.bTimePasses = true;
+    auto sequential = [](const TypSettings &settings, const vector<TypSortEngine> &engines) {
+        doSorts(settings, engines);
+    };
+    vector<string> sorts = runSweepForTest(dir, settings, engines, sequential);
+
+    // The expected lines, in order.
+    vector<string> expected;
+    for(const char *sortName : {"ShellSortLee21Passes", "ShellSortLee21KeyPtrPasses"}) {
+        for(int64_t n : {1000, 1001, 10000, 10001}) {
+            int igap;
+            for(igap=0; allGaps[GAP_LEE21][igap]<n; igap++);
+            while(--igap >= 0) {
+                expected.push_back(string(sortName) + "," + to_string(n) + ",301," +
+                                   to_string(allGaps[GAP_LEE21][igap]) + ",true");
+            }
+        }
+    }
+    FILE *file = fopen(settings.passFile.c_str(), "r");
+    char line[1024];
+    size_t nLines = 0;
+    while(NULL != file && NULL != fgets(line, sizeof(line), file)) {
+        // Drop the ns field, the fifth.
+        string rec = line;
+        rec.erase(rec.find_last_not_of('\n') + 1);
+        size_t comma4 = 0;
+        for(int j=0; j<4; j++) comma4 = rec.find(',', comma4 + 1);
+        size_t comma5 = rec.find(',', comma4 + 1);
+        rec.erase(comma4, comma5 - comma4);
+        if(nLines >= expected.size() || rec != expected[nLines]) {
+            printf("!! Unexpected pass line: %s", line);
+            bOK = false;
+            break;
+        }
+        nLines++;
+    }
+    if(NULL != file) fclose(file);
+    // The whole sorts are logged apart from untimed-pass ones.
+    for(const string &rec : sorts) {
+        if(string::npos == rec.find("Passes,")) {
+            printf("!! Sort with timed passes logged as %s\n", rec.c_str());
+            bOK = false;
+        }
+    }
+    if(nLines != expected.size() || sorts.size() != 8) {
+        printf("!! %d pass lines for %d sorts; expected %d for 8\n", (int) nLines, (int) sorts.size(),
+               (int) expected.size());
+        bOK = false;
+    }
+    unlink(settings.passFile.c_str());
+    rmdir(dir);
+    if(bOK) {
+        printf("Per-pass timing OK\n");
+    }
+}
+
+// Run the TopK engines, and StdSort for comparison, for various K, and
+// check that each gives the K smallest in order followed by the rest.
+void testTopK()
+{
+    printf("Testing top-K engines:\n");
+    bool bOK = true;
+    vector<TypSortEngine> engines;
+    selectEngines("TopK*,StdSort", engines);
+    const int64_t sizes[] = {0, 1, 2, 17, 1000, 5001};
+    const int64_t ks[] = {1, 2, 7, 16, 17, 100, 999, 1000, 1001, 6000};
+    const TypDist dists[] = {DIST_UNIFORM, DIST_SORTED, DIST_REVERSED, DIST_FEW_UNIQUE};
+    for(TypSortEngine &engine : engines) {
+        for(TypLayout layout=LAYOUT_PTR; layout<=LAYOUT_KEYPTR; layout=(TypLayout)(layout+1)) {
+            for(TypDist dist : dists) {
+                setInputDist(dist);
+                for(int64_t n : sizes) {
+                    for(int64_t k : ks) {
+                        setRandomSeed(4242 + n);
+                        DataRecord *arrayData;
+                        ArrayElementType *pArray = createArray(n, arrayData);
+                        KeyPtrElement *keyArray = new KeyPtrElement[n];
+                        TypSortParams params = engine.params;
+                        params.topK = k;
+                        runEngine(engine, params, layout, pArray, n, keyArray);
+                        bool bSame = checkTopKOrder(pArray, n, k);
+                        std::sort(pArray, pArray+n);
+                        for(int64_t j=0; bSame && j<n; j++) {
+                            bSame = pArray[j] == &arrayData[j];
+                        }
+                        if(!bSame) {
+                            printf("!! %s failed for the %lld smallest of %lld %s records\n",
+                                   logNameOf(engine, layout).c_str(), k, n, nameOfDist(dist));
+                            bOK = false;
+                        }
+                        delete []arrayData;
+                        delete []pArray;
+                        delete []keyArray;
+                    }
+                }
+            }
+        }
+    }
+    setInputDist(DIST_UNIFORM);
+
+    // checkTopKOrder must notice a smaller record after the first K, and
+    // must not mind disorder there.
+    const int64_t n = 100;
+    setRandomSeed(77);
+    DataRecord *arrayData;
+    ArrayElementType *pArray = createArray(n, arrayData);
+    engines[0].func(pArray, n, engines[0].params);
+    std::reverse(pArray+10, pArray+n);
+    if(!checkTopKOrder(pArray, n, 10) || checkTopKOrder(pArray, n, 11)) {
+        printf("!! checkTopKOrder wrong for disorder after the first K\n");
+        bOK = false;
+    }
+    std::swap(pArray[9], pArray[50]);
+    if(checkTopKOrder(pArray, n, 10)) {
+        printf("!! checkTopKOrder missed a smaller record after the first K\n");
+        bOK = false;
     }
     delete []arrayData;
     delete []pArray;
+    if(bOK) {
+        printf("Top-K engines OK\n");
+    }
 }
 
 void testGaps()
@@ -581,6 +4013,39 @@ void testGaps()
     printGaps();
 }
 
+// Check that the constexpr gap arrays match the computed sequences.
+void testConstGaps()
+{
+    struct TypConstGaps {
+        TypGap          gapType;
+        const int64_t   *gaps;
+        size_t          nGaps;
+    } constGaps[] = {
+        {GAP_CIURA_22, CONST_GAPS_CIURA_22.data(), CONST_GAPS_CIURA_22.size()},
+        {GAP_CIURA_225, CONST_GAPS_CIURA_225.data(), CONST_GAPS_CIURA_225.size()},
+        {GAP_CIURA_225_ODD, CONST_GAPS_CIURA_225_ODD.data(), CONST_GAPS_CIURA_225_ODD.size()},
+        {GAP_CIURA_235, CONST_GAPS_CIURA_235.data(), CONST_GAPS_CIURA_235.size()},
+        {GAP_JDAW1, CONST_GAPS_JDAW1.data(), CONST_GAPS_JDAW1.size()},
+        {GAP_KNUTH73, CONST_GAPS_KNUTH73.data(), CONST_GAPS_KNUTH73.size()},
+        {GAP_LEE21, CONST_GAPS_LEE21.data(), CONST_GAPS_LEE21.size()},
+        {GAP_TOKUDA92, CONST_GAPS_TOKUDA92.data(), CONST_GAPS_TOKUDA92.size()},
+    };
+    printf("Testing constexpr gap sequences:\n");
+    bool bOK = true;
+    for(const TypConstGaps &cg : constGaps) {
+        const int64_t *gaps = allGaps[cg.gapType];
+        size_t j;
+        for(j=0; gaps[j]>0 && j<cg.nGaps && gaps[j]==cg.gaps[j]; j++);
+        if(j != cg.nGaps || gaps[j] > 0) {
+            printf("!! Constexpr gaps for %s differ at gap %zu\n", nameOfGapType(cg.gapType), j);
+            bOK = false;
+        }
+    }
+    if(bOK) {
+        printf("Constexpr gap sequences OK\n");
+    }
+}
+
 int main(int argc, const char * argv[]) {
     int retcode = 0;
     TypSettings settings;
@@ -589,17 +4054,85 @@ int main(int argc, const char * argv[]) {
         retcode = 1;
     } else {
         buildGaps();
-        if(settings.bTest) {
+        buildEngines(settings);
+        setRandomThreads(settings.genThreads);
+        setDatasetCache(settings.cacheDir);
+        setInputDist(settings.dist);
+        keySpecInit(sortKey, settings.keyOff, settings.keyLen);
+        if(!timerInit(settings.timerSource)) {
+            printf("The time-stamp counter is not invariant; timing with the clock\n");
+        }
+        if(!mySetRandomLanes(settings.md5Lanes)) {
+            printf("%d-lane MD5 is not supported on this CPU; using %d\n", settings.md5Lanes, myRandomLanes());
+        }
+        vector<TypSortEngine> engines;
+        if(!selectEngines(settings.algoList, engines)) {
+            usage();
+            retcode = 1;
+        } else if(settings.bTest) {
             testTimer();
             testRNG();
+            testBulkRNG();
             testOrder();
             testGenArray();
             testGenAndShellSort();
             testGaps();
+            testConstGaps();
+            testEngines();
+            testParallelMergeSort();
+            testPerfCounters();
+            testOpCounts();
+            testArena();
+            testDatasetCache();
+            testDrivers();
+            testExternalSort();
+            testInputFile();
+            testDistributions();
+            testRecordSizes();
+            testKeyCompare();
+            testStats();
+            testTune();
+            testPassTiming();
+            testTopK();
+        } else if(settings.bCount) {
+            doCounts(settings, engines);
+        } else if(settings.bTune) {
+            openLogFile(settings.outputFile.c_str());
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            TypTuneCandidate winner;
+            doTune(settings, winner);
+            closeLogFile();
+            if(settings.bStats) closeStatsFile();
+        } else if(!settings.inFile.empty()) {
+            openLogFile(settings.outputFile.c_str());
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            doInputSorts(settings, engines);
+            closeLogFile();
+            if(settings.bStats) closeStatsFile();
+        } else if(settings.bExternal) {
+            openLogFile(settings.outputFile.c_str());
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            doExternalSorts(settings, engines);
+            closeLogFile();
+            if(settings.bStats) closeStatsFile();
+        } else if(settings.nJobs > 1) {
+            openLogFile(settings.outputFile.c_str());
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            doJobSorts(settings, engines);
+            closeLogFile();
+            if(settings.bStats) closeStatsFile();
+        } else if(settings.bPipeline) {
+            openLogFile(settings.outputFile.c_str());
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            doPipelinedSorts(settings, engines);
+            closeLogFile();
+            if(settings.bStats) closeStatsFile();
         } else {
             openLogFile(settings.outputFile.c_str());
-            doSorts(settings);
+            if(settings.bStats) openStatsFile(settings.statsFile.c_str());
+            doSorts(settings, engines);
             closeLogFile();
+            if(settings.bStats) closeStatsFile();
         }
     }
     return retcode;
@@ -0,0 +1,617 @@
+//
+//  sortengines.h
+//  sortbench
+//
+//  Comparison sorts to benchmark against Shellsort: introsort,
+//  pattern-defeating quicksort, heapsort and merge sort, plus a generic
+//  Shellsort and partial (top-K) sorts.
+//  They are templates on the element type and on a "greater than"
+//  functor, so they work with the same comparison as shellSort().
+//
+
+#ifndef sortengines_h
+#define sortengines_h
+
+#include <stdint.h>
+#include <utility>
+
+// Partitions at or below this size are finished with insertion sort.
+const int64_t SMALL_SORT_THRESHOLD = 16;
+// pdqsort uses a ninther (median of medians) pivot above this size.
+const int64_t NINTHER_THRESHOLD = 128;
+
+// Returns floor(log2(n)), for computing recursion limits.
+inline int log2Floor(int64_t n)
+{
+    int log = 0;
+    while(n > 1) {
+        n >>= 1;
+        log++;
+    }
+    return log;
+}
+
+// Straight insertion sort of a[0..n-1].
+template<typename T, typename Greater>
+void insertionSortT(T a[], int64_t n, Greater gt)
+{
+    for(int64_t i=1; i<n; i++) {
+        T temp = a[i];
+        int64_t j;
+        for(j=i; j>0 && gt(a[j-1], temp); j--) {
+            a[j] = a[j-1];
+        }
+        a[j] = temp;
+    }
+}
+
+// Order three elements in place so that x <= y <= z.
+template<typename T, typename Greater>
+void sort3T(T &x, T &y, T &z, Greater gt)
+{
+    if(gt(x, y)) std::swap(x, y);
+    if(gt(y, z)) std::swap(y, z);
+    if(gt(x, y)) std::swap(x, y);
+}
+
+//=====  Shellsort  ===================================================
+// Same algorithm and loop structure as shellSort() in sortbench.cpp, for
+// element types other than ArrayElementType.
+
+// A Shellsort pass hook is told when each gap pass begins and ends, for
+// instrumentation.  This one does nothing and compiles away.
+struct NoShellPassHook {
+    void beginPass(int64_t gap) {}
+    void endPass(int64_t gap) {}
+};
+
+template<typename T, typename Greater, typename PassHook = NoShellPassHook>
+void shellSortT(T a[], int64_t n, const int64_t gaps[], Greater gt, PassHook hook = PassHook())
+{
+    T temp;
+    int64_t gap, igap, i, j;
+
+    if(n <= 1) return;
+
+    // Find the gap to start with.
+    for(igap=0; gaps[igap]<n && gaps[igap]>0; igap++);
+    igap--;
+
+    for(; igap>=0; igap--) {
+        gap = gaps[igap];
+        hook.beginPass(gap);
+        for(i=gap; i<n; i++) {
+            temp = a[i];
+            for(j=i; (j>=gap) && gt(a[j-gap], temp); j -= gap) {
+                a[j] = a[j-gap];
+            }
+            a[j] = temp;
+        }
+        hook.endPass(gap);
+    }
+}
+
+//=====  Shellsort with compile-time gaps  ============================
+// The gap sequence is a constexpr array, and each pass is instantiated
+// with its gap as a constant, so j-GAP and j>=GAP become immediate
+// operands and the gap-1 pass is a plain insertion sort.  Which passes
+// run still depends on n: every gap below n, largest first, exactly as
+// shellSortT() does.
+
+template<int64_t GAP, typename T, typename Greater>
+void shellPassFixedT(T a[], int64_t n, Greater gt)
+{
+    for(int64_t i=GAP; i<n; i++) {
+        T temp = a[i];
+        int64_t j;
+        for(j=i; (j>=GAP) && gt(a[j-GAP], temp); j -= GAP) {
+            a[j] = a[j-GAP];
+        }
+        a[j] = temp;
+    }
+}
+
+template<const auto &GAPS, typename T, typename Greater, size_t... I>
+void shellSortFixedPassesT(T a[], int64_t n, Greater gt, std::index_sequence<I...>)
+{
+    constexpr size_t N = sizeof...(I);
+    ((GAPS[N-1-I] < n ? shellPassFixedT<GAPS[N-1-I]>(a, n, gt) : (void) 0), ...);
+}
+
+// Sort with the increasing gaps in the std::array GAPS.
+template<const auto &GAPS, typename T, typename Greater>
+void shellSortFixedT(T a[], int64_t n, Greater gt)
+{
+    if(n <= 1) return;
+    shellSortFixedPassesT<GAPS>(a, n, gt, std::make_index_sequence<GAPS.size()>());
+}
+
+//=====  Cache-blocked Shellsort  =====================================
+// In a pass with a large gap, each step of an insertion walk hops gap
+// elements, so every comparison is a cache miss on the array and on the
+// record an element points to.  This variant inserts a batch of
+// BLOCKED_SHELL_LANES consecutive positions i..i+LANES-1 together, taking
+// one step of every lane's walk before the next.  The lanes lie in
+// neighbouring chains, so at each step they read neighbouring slots of the
+// same cache lines, and their record loads are independent, so they can
+// be in flight at once.  Because gap >= BLOCKED_SHELL_LANES, the earlier
+// elements of each lane's chain were inserted by earlier batches, and the
+// result is the same as shellSortT's.
+// It also prefetches the slots the batch BLOCKED_SHELL_AHEAD positions
+// later starts from, and the records they point to, and at each step the
+// slots two hops further down.
+// On the machines measured so far it is slower than shellSortT, whose
+// loads the hardware already overlaps; it is kept to measure that.
+
+// Passes with smaller gaps fit in cache and use the ordinary loop.
+const int64_t BLOCKED_SHELL_MIN_GAP = 1024;
+// Chains inserted together.  At most 32, the bits of the active mask.
+const int BLOCKED_SHELL_LANES = 8;
+// How many positions ahead of the current batch to prefetch.
+const int64_t BLOCKED_SHELL_AHEAD = 32;
+
+// Prefetches nothing an element refers to; for elements that hold their keys.
+struct NoElementPrefetch {
+    template<typename T>
+    void operator()(const T &elem) const {}
+};
+
+// One pass with gap >= BLOCKED_SHELL_MIN_GAP.
+// Entry:   prefetch    is called on an element to prefetch what it refers to.
+template<typename T, typename Greater, typename Prefetch>
+void shellPassBlockedT(T a[], int64_t n, int64_t gap, Greater gt, Prefetch prefetch)
+{
+    const int lanes = BLOCKED_SHELL_LANES;
+    int64_t i;
+    for(i=gap; i+lanes<=n; i+=lanes) {
+        int64_t ahead = i + BLOCKED_SHELL_AHEAD;
+        if(ahead + lanes <= n) {
+            __builtin_prefetch(&a[ahead]);
+            __builtin_prefetch(&a[ahead + lanes-1]);
+            __builtin_prefetch(&a[ahead - gap]);
+            __builtin_prefetch(&a[ahead - gap + lanes-1]);
+            for(int k=0; k<lanes; k++) {
+                prefetch(a[ahead - gap + k]);
+            }
+        }
+        T temp[lanes];
+        for(int k=0; k<lanes; k++) {
+            temp[k] = a[i+k];
+        }
+        // Lane k is at a[j+k]; its bit is set while its walk goes on.
+        uint32_t active = (1u << lanes) - 1;
+        int64_t j;
+        for(j=i; active && j>=gap; j -= gap) {
+            if(j >= 3*gap) {
+                __builtin_prefetch(&a[j - 3*gap]);
+                __builtin_prefetch(&a[j - 3*gap + lanes-1]);
+            }
+            for(int k=0; k<lanes; k++) {
+                if(0 == (active & (1u << k))) continue;
+                if(gt(a[j-gap+k], temp[k])) {
+                    a[j+k] = a[j-gap+k];
+                } else {
+                    a[j+k] = temp[k];
+                    active &= ~(1u << k);
+                }
+            }
+        }
+        // The lanes still active have reached the fronts of their chains,
+        // or, since gap need not be a multiple of lanes, the higher lanes
+        // may have one more step.
+        for(int k=0; k<lanes; k++) {
+            if(0 == (active & (1u << k))) continue;
+            int64_t jk = j + k;
+            for(; jk>=gap && gt(a[jk-gap], temp[k]); jk -= gap) {
+                a[jk] = a[jk-gap];
+            }
+            a[jk] = temp[k];
+        }
+    }
+    for(; i<n; i++) {
+        T temp = a[i];
+        int64_t j;
+        for(j=i; (j>=gap) && gt(a[j-gap], temp); j -= gap) {
+            a[j] = a[j-gap];
+        }
+        a[j] = temp;
+    }
+}
+
+// Shellsort with the same gaps and result as shellSortT, using
+// shellPassBlockedT for passes with gaps of BLOCKED_SHELL_MIN_GAP or more.
+template<typename T, typename Greater, typename Prefetch>
+void blockedShellSortT(T a[], int64_t n, const int64_t gaps[], Greater gt, Prefetch prefetch)
+{
+    int64_t igap;
+    if(n <= 1) return;
+    for(igap=0; gaps[igap]<n && gaps[igap]>0; igap++);
+    igap--;
+    for(; igap>=0; igap--) {
+        int64_t gap = gaps[igap];
+        if(gap >= BLOCKED_SHELL_MIN_GAP) {
+            shellPassBlockedT(a, n, gap, gt, prefetch);
+        } else {
+            for(int64_t i=gap; i<n; i++) {
+                T temp = a[i];
+                int64_t j;
+                for(j=i; (j>=gap) && gt(a[j-gap], temp); j -= gap) {
+                    a[j] = a[j-gap];
+                }
+                a[j] = temp;
+            }
+        }
+    }
+}
+
+//=====  Heapsort  ====================================================
+
+// Move a[root] down a max-heap of n elements until the heap property holds.
+template<typename T, typename Greater>
+void siftDownT(T a[], int64_t root, int64_t n, Greater gt)
+{
+    T temp = a[root];
+    int64_t child;
+    while((child = 2*root + 1) < n) {
+        if(child+1 < n && gt(a[child+1], a[child])) {
+            child++;
+        }
+        if(!gt(a[child], temp)) break;
+        a[root] = a[child];
+        root = child;
+    }
+    a[root] = temp;
+}
+
+template<typename T, typename Greater>
+void heapSortT(T a[], int64_t n, Greater gt)
+{
+    for(int64_t i=n/2-1; i>=0; i--) {
+        siftDownT(a, i, n, gt);
+    }
+    for(int64_t end=n-1; end>0; end--) {
+        std::swap(a[0], a[end]);
+        siftDownT(a, 0, end, gt);
+    }
+}
+
+//=====  Introsort  ===================================================
+// Median-of-3 quicksort that falls back to heapsort when the recursion
+// gets too deep, as in Musser's original paper.
+
+template<typename T, typename Greater>
+void introSortLoopT(T a[], int64_t n, int depthLimit, Greater gt)
+{
+    while(n > SMALL_SORT_THRESHOLD) {
+        if(0 == depthLimit) {
+            heapSortT(a, n, gt);
+            return;
+        }
+        depthLimit--;
+        // After sort3T, a[0] and a[n-1] act as sentinels for the scans below.
+        sort3T(a[0], a[n/2], a[n-1], gt);
+        T pivot = a[n/2];
+        int64_t i = 0, j = n-1;
+        for(;;) {
+            do i++; while(gt(pivot, a[i]));
+            do j--; while(gt(a[j], pivot));
+            if(i >= j) break;
+            std::swap(a[i], a[j]);
+        }
+        // a[0..i-1] <= pivot <= a[i..n-1].  Recurse on the smaller side.
+        if(i < n-i) {
+            introSortLoopT(a, i, depthLimit, gt);
+            a += i;
+            n -= i;
+        } else {
+            introSortLoopT(a+i, n-i, depthLimit, gt);
+            n = i;
+        }
+    }
+    insertionSortT(a, n, gt);
+}
+
+template<typename T, typename Greater>
+void introSortT(T a[], int64_t n, Greater gt)
+{
+    if(n <= 1) return;
+    introSortLoopT(a, n, 2*log2Floor(n), gt);
+}
+
+//=====  Pattern-defeating quicksort  =================================
+// After Orson Peters' pdqsort (https://github.com/orlp/pdqsort), without
+// the block partitioning.  Already-partitioned inputs are detected and
+// finished with a bounded insertion sort, runs of equal elements are
+// split off in one pass, and bad partitions are broken up by swapping
+// elements before heapsort is used as a last resort.
+
+// Insertion sort that gives up if it has to move too many elements.
+// Returns true if the array was sorted.
+template<typename T, typename Greater>
+bool partialInsertionSortT(T a[], int64_t n, Greater gt)
+{
+    const int64_t PARTIAL_INSERTION_LIMIT = 8;
+    int64_t moved = 0;
+    for(int64_t cur=1; cur<n; cur++) {
+        if(gt(a[cur-1], a[cur])) {
+            T temp = a[cur];
+            int64_t j = cur;
+            do {
+                a[j] = a[j-1];
+                j--;
+            } while(j>0 && gt(a[j-1], temp));
+            a[j] = temp;
+            moved += cur - j;
+        }
+        if(moved > PARTIAL_INSERTION_LIMIT) return false;
+    }
+    return true;
+}
+
+// Partition around the pivot a[0], putting elements equal to the pivot
+// on the right.  Returns the final position of the pivot and sets
+// bAlreadyPartitioned if no elements had to be swapped.
+template<typename T, typename Greater>
+int64_t pdqPartitionRightT(T a[], int64_t n, bool &bAlreadyPartitioned, Greater gt)
+{
+    T pivot = a[0];
+    int64_t first = 0, last = n;
+    // The median-of-3 pivot choice guarantees an element >= pivot exists.
+    while(gt(pivot, a[++first]));
+    if(first-1 == 0) {
+        while(first < last && !gt(pivot, a[--last]));
+    } else {
+        while(!gt(pivot, a[--last]));
+    }
+    bAlreadyPartitioned = first >= last;
+    while(first < last) {
+        std::swap(a[first], a[last]);
+        while(gt(pivot, a[++first]));
+        while(!gt(pivot, a[--last]));
+    }
+    int64_t pivotPos = first - 1;
+    a[0] = a[pivotPos];
+    a[pivotPos] = pivot;
+    return pivotPos;
+}
+
+// Partition around the pivot a[0], putting elements equal to the pivot
+// on the left.  Used when the pivot equals the element just before this
+// partition, in which case everything left of the result is already done.
+template<typename T, typename Greater>
+int64_t pdqPartitionLeftT(T a[], int64_t n, Greater gt)
+{
+    T pivot = a[0];
+    int64_t first = 0, last = n;
+    while(gt(a[--last], pivot));
+    if(last+1 == n) {
+        while(first < last && !gt(a[++first], pivot));
+    } else {
+        while(!gt(a[++first], pivot));
+    }
+    while(first < last) {
+        std::swap(a[first], a[last]);
+        while(gt(a[--last], pivot));
+        while(!gt(a[++first], pivot));
+    }
+    a[0] = a[last];
+    a[last] = pivot;
+    return last;
+}
+
+template<typename T, typename Greater>
+void pdqSortLoopT(T a[], int64_t n, int badAllowed, bool bLeftmost, Greater gt)
+{
+    for(;;) {
+        if(n <= SMALL_SORT_THRESHOLD) {
+            insertionSortT(a, n, gt);
+            return;
+        }
+
+        // Choose a pivot and move it to a[0].
+        int64_t half = n/2;
+        if(n > NINTHER_THRESHOLD) {
+            sort3T(a[0], a[half], a[n-1], gt);
+            sort3T(a[1], a[half-1], a[n-2], gt);
+            sort3T(a[2], a[half+1], a[n-3], gt);
+            sort3T(a[half-1], a[half], a[half+1], gt);
+            std::swap(a[0], a[half]);
+        } else {
+            sort3T(a[half], a[0], a[n-1], gt);
+        }
+
+        // If the element before this partition equals the pivot, there
+        // are many duplicates; split them all off at once.
+        if(!bLeftmost && !gt(a[0], a[-1])) {
+            int64_t pivotPos = pdqPartitionLeftT(a, n, gt);
+            a += pivotPos + 1;
+            n -= pivotPos + 1;
+            continue;
+        }
+
+        bool bAlreadyPartitioned;
+        int64_t pivotPos = pdqPartitionRightT(a, n, bAlreadyPartitioned, gt);
+        int64_t lSize = pivotPos;
+        int64_t rSize = n - pivotPos - 1;
+
+        if(lSize < n/8 || rSize < n/8) {
+            // Bad partition: after too many, give up on quicksort.
+            if(0 == --badAllowed) {
+                heapSortT(a, n, gt);
+                return;
+            }
+            // Otherwise shuffle some elements to break up the pattern.
+            if(lSize >= SMALL_SORT_THRESHOLD) {
+                std::swap(a[0], a[lSize/4]);
+                std::swap(a[pivotPos-1], a[pivotPos-lSize/4]);
+                if(lSize > NINTHER_THRESHOLD) {
+                    std::swap(a[1], a[lSize/4+1]);
+                    std::swap(a[2], a[lSize/4+2]);
+                    std::swap(a[pivotPos-2], a[pivotPos-(lSize/4+1)]);
+                    std::swap(a[pivotPos-3], a[pivotPos-(lSize/4+2)]);
+                }
+            }
+            if(rSize >= SMALL_SORT_THRESHOLD) {
+                T *r = a + pivotPos + 1;
+                std::swap(r[0], r[rSize/4]);
+                std::swap(a[n-1], a[n-rSize/4]);
+                if(rSize > NINTHER_THRESHOLD) {
+                    std::swap(r[1], r[rSize/4+1]);
+                    std::swap(r[2], r[rSize/4+2]);
+                    std::swap(a[n-2], a[n-(1+rSize/4)]);
+                    std::swap(a[n-3], a[n-(2+rSize/4)]);
+                }
+            }
+        } else if(bAlreadyPartitioned &&
+                  partialInsertionSortT(a, lSize, gt) &&
+                  partialInsertionSortT(a+pivotPos+1, rSize, gt)) {
+            // The input looks nearly sorted and turned out to be.
+            return;
+        }
+
+        pdqSortLoopT(a, lSize, badAllowed, bLeftmost, gt);
+        a += pivotPos + 1;
+        n = rSize;
+        bLeftmost = false;
+    }
+}
+
+template<typename T, typename Greater>
+void pdqSortT(T a[], int64_t n, Greater gt)
+{
+    if(n <= 1) return;
+    pdqSortLoopT(a, n, log2Floor(n), true, gt);
+}
+
+//=====  Merge sort  ==================================================
+// Top-down stable merge sort.  Only the left half is copied out before
+// merging, so the buffer needs n/2 elements.
+
+template<typename T, typename Greater>
+void mergeSortRecT(T a[], int64_t n, T buf[], Greater gt)
+{
+    if(n <= SMALL_SORT_THRESHOLD) {
+        insertionSortT(a, n, gt);
+        return;
+    }
+    int64_t mid = n/2;
+    mergeSortRecT(a, mid, buf, gt);
+    mergeSortRecT(a+mid, n-mid, buf, gt);
+    // Skip the merge if the halves are already in order.
+    if(!gt(a[mid-1], a[mid])) return;
+
+    for(int64_t k=0; k<mid; k++) {
+        buf[k] = a[k];
+    }
+    int64_t i=0, j=mid, k=0;
+    while(i<mid && j<n) {
+        if(gt(buf[i], a[j])) {
+            a[k++] = a[j++];
+        } else {
+            a[k++] = buf[i++];
+        }
+    }
+    while(i<mid) {
+        a[k++] = buf[i++];
+    }
+}
+
+template<typename T, typename Greater>
+void mergeSortT(T a[], int64_t n, Greater gt)
+{
+    if(n <= 1) return;
+    T *buf = new T[n/2];
+    mergeSortRecT(a, n, buf, gt);
+    delete []buf;
+}
+
+//=====  Top-K  =======================================================
+// Partial sorts: each leaves the k smallest elements in order in
+// a[0..k-1], and the rest, in no particular order, after them.
+// Entry:   0 <= k <= n.
+
+// Bounded heap: a max-heap of the k smallest so far, whose root, the
+// largest of them, is replaced by any smaller element that comes along.
+template<typename T, typename Greater>
+void topKHeapT(T a[], int64_t n, int64_t k, Greater gt)
+{
+    for(int64_t i=k/2-1; i>=0; i--) {
+        siftDownT(a, i, k, gt);
+    }
+    for(int64_t j=k; j<n; j++) {
+        if(gt(a[0], a[j])) {
+            std::swap(a[0], a[j]);
+            siftDownT(a, 0, k, gt);
+        }
+    }
+    for(int64_t end=k-1; end>0; end--) {
+        std::swap(a[0], a[end]);
+        siftDownT(a, 0, end, gt);
+    }
+}
+
+// Quickselect: partition as introSortLoopT does, but go on only into the
+// side holding the k'th element.  Leaves the k smallest in a[0..k-1], in
+// no particular order.  Too many bad partitions fall back to the heap.
+template<typename T, typename Greater>
+void quickSelectT(T a[], int64_t n, int64_t k, Greater gt)
+{
+    int depthLimit = 2*log2Floor(n);
+    while(n > SMALL_SORT_THRESHOLD && k > 0 && k < n) {
+        if(0 == depthLimit) {
+            topKHeapT(a, n, k, gt);
+            return;
+        }
+        depthLimit--;
+        sort3T(a[0], a[n/2], a[n-1], gt);
+        T pivot = a[n/2];
+        int64_t i = 0, j = n-1;
+        for(;;) {
+            do i++; while(gt(pivot, a[i]));
+            do j--; while(gt(a[j], pivot));
+            if(i >= j) break;
+            std::swap(a[i], a[j]);
+        }
+        // a[0..i-1] <= pivot <= a[i..n-1].
+        if(k <= i) {
+            n = i;
+        } else {
+            a += i;
+            n -= i;
+            k -= i;
+        }
+    }
+    if(k > 0 && k < n) insertionSortT(a, n, gt);
+}
+
+template<typename T, typename Greater>
+void topKSelectT(T a[], int64_t n, int64_t k, Greater gt)
+{
+    quickSelectT(a, n, k, gt);
+    pdqSortT(a, k, gt);
+}
+
+// Shellsort-based: a[0..len-1] holds the k smallest so far, in order,
+// followed by the elements less than the k'th of them that have come
+// along since.  When that buffer reaches 2k, it is Shellsorted, which is
+// quick as its first half is already in order, and cut back to k.
+template<typename T, typename Greater>
+void topKShellSortT(T a[], int64_t n, int64_t k, const int64_t gaps[], Greater gt)
+{
+    if(k <= 0) return;
+    int64_t capacity = 2*k < n ? 2*k : n;
+    shellSortT(a, k, gaps, gt);
+    int64_t len = k;
+    for(int64_t j=k; j<n; j++) {
+        if(gt(a[k-1], a[j])) {
+            std::swap(a[len++], a[j]);
+            if(len == capacity) {
+                shellSortT(a, len, gaps, gt);
+                len = k;
+            }
+        }
+    }
+    if(len > k) shellSortT(a, len, gaps, gt);
+}
+
+#endif /* sortengines_h */
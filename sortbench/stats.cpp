@@ -0,0 +1,104 @@
+//
+//  stats.cpp
+//  sortbench
+//
+
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+
+// Scales a MAD to estimate the standard deviation of normal data.
+static const double MAD_SCALE = 1.4826;
+static const uint64_t BOOTSTRAP_SEED = 0x9e3779b97f4a7c15ULL;
+
+// Returns the median of sorted values.
+static double medianOfSorted(const std::vector<double> &sorted)
+{
+    size_t n = sorted.size();
+    if(0 == n) return 0;
+    return 0 == n % 2 ? 0.5 * (sorted[n/2 - 1] + sorted[n/2]) : sorted[n/2];
+}
+
+// Returns the median of values, reordering them.
+static double medianOf(std::vector<double> &values)
+{
+    size_t n = values.size();
+    if(0 == n) return 0;
+    std::vector<double>::iterator mid = values.begin() + n/2;
+    std::nth_element(values.begin(), mid, values.end());
+    if(1 == n % 2) return *mid;
+    return 0.5 * (*std::max_element(values.begin(), mid) + *mid);
+}
+
+// splitmix64: enough for choosing resamples, and independent of the
+// generator that makes the records.
+static uint64_t nextBootstrapRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void statsCompute(const std::vector<double> &samples, TypStats &stats)
+{
+    stats = TypStats();
+    stats.nRuns = (int64_t) samples.size();
+    if(samples.empty()) return;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    double median = medianOfSorted(sorted);
+    std::vector<double> deviations;
+    for(double x : samples) {
+        deviations.push_back(fabs(x - median));
+    }
+    double mad = MAD_SCALE * medianOf(deviations);
+
+    // If more than half the runs are identical the MAD is 0, and nothing
+    // is rejected.
+    std::vector<double> kept;
+    for(double x : sorted) {
+        if(0 == mad || fabs(x - median) <= STATS_OUTLIER_MADS * mad) {
+            kept.push_back(x);
+        }
+    }
+    stats.nRejected = stats.nRuns - (int64_t) kept.size();
+    size_t n = kept.size();
+
+    stats.median = medianOfSorted(kept);
+    deviations.clear();
+    double sum = 0;
+    for(double x : kept) {
+        deviations.push_back(fabs(x - stats.median));
+        sum += x;
+    }
+    stats.mad = MAD_SCALE * medianOf(deviations);
+    stats.mean = sum / n;
+    size_t nTrim = (size_t) (STATS_TRIM * n);
+    double sumTrimmed = 0;
+    for(size_t j=nTrim; j<n-nTrim; j++) {
+        sumTrimmed += kept[j];
+    }
+    stats.trimmedMean = sumTrimmed / (n - 2*nTrim);
+
+    // Percentile bootstrap of the median.
+    std::vector<double> medians(STATS_BOOTSTRAP_RESAMPLES);
+    std::vector<double> resample(n);
+    uint64_t state = BOOTSTRAP_SEED;
+    for(double &resampledMedian : medians) {
+        for(size_t j=0; j<n; j++) {
+            resample[j] = kept[nextBootstrapRandom(state) % n];
+        }
+        resampledMedian = medianOf(resample);
+    }
+    std::sort(medians.begin(), medians.end());
+    double tail = 0.5 * (1 - STATS_CONFIDENCE);
+    stats.ciLow = medians[(size_t) (tail * (STATS_BOOTSTRAP_RESAMPLES - 1))];
+    stats.ciHigh = medians[(size_t) ((1 - tail) * (STATS_BOOTSTRAP_RESAMPLES - 1))];
+}
+
+double statsRelativeCIWidth(const TypStats &stats)
+{
+    return 0 == stats.median ? 0 : (stats.ciHigh - stats.ciLow) / stats.median;
+}
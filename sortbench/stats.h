@@ -0,0 +1,43 @@
+//
+//  stats.h
+//  sortbench
+//
+//  Summary statistics of repeated benchmark runs, computed in the program
+//  instead of afterwards by avesortbench.awk.  Runs far from the median,
+//  as measured by the median absolute deviation (MAD), are rejected as
+//  outliers; the median, trimmed mean and a bootstrap confidence interval
+//  for the median are then computed from the runs that remain.
+//
+
+#ifndef stats_h
+#define stats_h
+
+#include <stdint.h>
+#include <vector>
+
+// Runs more than this many scaled MADs from the median are outliers.
+const double STATS_OUTLIER_MADS = 3.5;
+// Fraction of the remaining runs dropped from each end for the trimmed mean.
+const double STATS_TRIM = 0.1;
+const int STATS_BOOTSTRAP_RESAMPLES = 1000;
+const double STATS_CONFIDENCE = 0.95;
+
+struct TypStats {
+    int64_t nRuns = 0;          // Samples given.
+    int64_t nRejected = 0;      // Outliers left out of everything below.
+    double  median = 0;
+    double  mad = 0;            // Scaled by 1.4826, to estimate a standard deviation.
+    double  mean = 0;
+    double  trimmedMean = 0;
+    double  ciLow = 0;          // Confidence interval for the median.
+    double  ciHigh = 0;
+};
+
+// Compute stats for samples.  The bootstrap uses a fixed seed, so the
+// same samples always give the same interval.
+void statsCompute(const std::vector<double> &samples, TypStats &stats);
+
+// Width of the confidence interval relative to the median.
+double statsRelativeCIWidth(const TypStats &stats);
+
+#endif /* stats_h */
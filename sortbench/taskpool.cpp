@@ -0,0 +1,106 @@
+//
+//  taskpool.cpp
+//  sortbench
+//
+
+#include "taskpool.h"
+
+// Take a task for worker iworker: the newest of its own, or else the
+// oldest of the first other worker that has one.
+static bool taskPoolTake(TaskPool *pool, int iworker, Task &task)
+{
+    int nWorkers = (int) pool->workers.size();
+    for(int k=0; k<nWorkers; k++) {
+        int ivictim = (iworker + k) % nWorkers;
+        TaskWorker *victim = pool->workers[ivictim].get();
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if(victim->tasks.empty()) continue;
+        if(0 == k) {
+            task = std::move(victim->tasks.back());
+            victim->tasks.pop_back();
+        } else {
+            task = std::move(victim->tasks.front());
+            victim->tasks.pop_front();
+            pool->nSteals.fetch_add(1, std::memory_order_relaxed);
+        }
+        pool->nQueued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+static void taskRun(int iworker, Task &task)
+{
+    task.func(iworker);
+    task.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void taskPoolThread(TaskPool *pool, int iworker)
+{
+    Task task;
+    while(!pool->bStop.load()) {
+        if(taskPoolTake(pool, iworker, task)) {
+            taskRun(iworker, task);
+        } else {
+            std::unique_lock<std::mutex> idle(pool->idleLock);
+            pool->wake.wait(idle, [pool] { return pool->bStop.load() || pool->nQueued.load() > 0; });
+        }
+    }
+}
+
+void taskPoolStart(TaskPool *pool, int nThreads)
+{
+    if(nThreads < 1) nThreads = 1;
+    pool->bStop = false;
+    pool->nQueued = 0;
+    pool->nSteals = 0;
+    for(int j=0; j<nThreads; j++) {
+        pool->workers.emplace_back(new TaskWorker);
+    }
+    for(int j=1; j<nThreads; j++) {
+        pool->threads.emplace_back(taskPoolThread, pool, j);
+    }
+}
+
+void taskPoolSpawn(TaskPool *pool, int iworker, TaskGroup *group, TaskFunc func)
+{
+    group->pending.fetch_add(1);
+    TaskWorker *worker = pool->workers[iworker].get();
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->tasks.push_back(Task{std::move(func), group});
+    }
+    pool->nQueued.fetch_add(1);
+    // Taking the lock orders this with an idle thread's check of nQueued,
+    // so the notification can't be missed.
+    {
+        std::lock_guard<std::mutex> guard(pool->idleLock);
+    }
+    pool->wake.notify_one();
+}
+
+void taskPoolWait(TaskPool *pool, int iworker, TaskGroup *group)
+{
+    Task task;
+    while(group->pending.load(std::memory_order_acquire) > 0) {
+        if(taskPoolTake(pool, iworker, task)) {
+            taskRun(iworker, task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void taskPoolStop(TaskPool *pool)
+{
+    {
+        std::lock_guard<std::mutex> guard(pool->idleLock);
+        pool->bStop = true;
+    }
+    pool->wake.notify_all();
+    for(std::thread &thr : pool->threads) {
+        thr.join();
+    }
+    pool->threads.clear();
+    pool->workers.clear();
+}
@@ -0,0 +1,66 @@
+//
+//  taskpool.h
+//  sortbench
+//
+//  A work-stealing pool of threads for fork-join parallel sorts.  Each
+//  worker has its own deque of tasks: it pushes and pops its own tasks
+//  at the back, so it works depth-first on the newest, smallest pieces,
+//  and when it runs out it steals from the front of another worker's
+//  deque, taking the oldest, largest pieces.  The thread that starts the
+//  pool is worker 0, and works too while it waits.
+//
+
+#ifndef taskpool_h
+#define taskpool_h
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks are given the index of the worker running them, which they pass
+// on when spawning or waiting.
+typedef std::function<void(int iworker)> TaskFunc;
+
+// A set of tasks that someone waits for.
+struct TaskGroup {
+    std::atomic<int64_t> pending{0};
+};
+
+struct Task {
+    TaskFunc    func;
+    TaskGroup   *group = NULL;
+};
+
+struct TaskWorker {
+    std::mutex          lock;
+    std::deque<Task>    tasks;
+};
+
+struct TaskPool {
+    std::vector<std::unique_ptr<TaskWorker>> workers;
+    std::vector<std::thread> threads;
+    // Idle threads sleep on wake until a task is queued or the pool stops.
+    std::mutex          idleLock;
+    std::condition_variable wake;
+    std::atomic<int64_t> nQueued{0};
+    std::atomic<bool>   bStop{false};
+    // Total tasks stolen, for tests.
+    std::atomic<int64_t> nSteals{0};
+};
+
+// Start nThreads-1 threads; the caller is worker 0.
+void taskPoolStart(TaskPool *pool, int nThreads);
+// Queue func on worker iworker's deque, as part of group.
+void taskPoolSpawn(TaskPool *pool, int iworker, TaskGroup *group, TaskFunc func);
+// Run or steal tasks until every task of group has finished.
+void taskPoolWait(TaskPool *pool, int iworker, TaskGroup *group);
+// Stop and join the threads.  No tasks may be pending.
+void taskPoolStop(TaskPool *pool);
+
+#endif /* taskpool_h */
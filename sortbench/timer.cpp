@@ -0,0 +1,127 @@
+//
+//  timer.cpp
+//  sortbench
+//
+
+#include "timer.h"
+#include <time.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#if TIMER_HAVE_TSC
+#include <cpuid.h>
+#endif
+
+TypTimer timer;
+
+// How long to count TSC ticks against the clock when calibrating.
+static const sb_timer_t TIMER_CALIBRATION_NS = 20000000;
+// Empty intervals timed to find the overhead.
+static const int TIMER_OVERHEAD_SAMPLES = 1000;
+
+const char *nameOfTimerSource(TypTimerSource source)
+{
+    const char *names[TIMER_MAX] = {"clock", "tsc"};
+    return source < TIMER_MAX ? names[source] : "unknown";
+}
+
+sb_timer_t getCurrentNanoseconds()
+{
+#ifdef __APPLE__
+    // http://www.manpagez.com/man/3/clock_gettime_nsec_np/
+    sb_timer_t nano = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    sb_timer_t nano = (sb_timer_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    return nano;
+}
+
+bool timerHaveInvariantTsc()
+{
+#if TIMER_HAVE_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if(0 == __get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) return false;
+    // rdtscp is CPUID 0x80000001 EDX bit 27; invariant TSC is 0x80000007 EDX bit 8.
+    __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    bool bRdtscp = 0 != (edx & (1u << 27));
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return bRdtscp && 0 != (edx & (1u << 8));
+#else
+    return false;
+#endif
+}
+
+// Returns nanoseconds per TSC tick, counting ticks while the clock
+// advances TIMER_CALIBRATION_NS.
+static double timerCalibrateTsc()
+{
+#if TIMER_HAVE_TSC
+    sb_timer_t clockStart = getCurrentNanoseconds();
+    uint64_t tscStart = __rdtsc();
+    sb_timer_t clockNow;
+    do {
+        clockNow = getCurrentNanoseconds();
+    } while(clockNow - clockStart < TIMER_CALIBRATION_NS);
+    uint64_t tscStop = __rdtsc();
+    return (double) (clockNow - clockStart) / (tscStop - tscStart);
+#else
+    return 1.0;
+#endif
+}
+
+// Time nSamples empty intervals, in ticks.
+static void timerEmptyIntervals(int nSamples, std::vector<uint64_t> &ticks)
+{
+    ticks.resize(nSamples);
+    for(uint64_t &interval : ticks) {
+        uint64_t start = timerStart();
+        interval = timerStop() - start;
+    }
+}
+
+bool timerInit(TypTimerSource source)
+{
+    bool bOK = true;
+    if(TIMER_TSC == source && !timerHaveInvariantTsc()) {
+        source = TIMER_CLOCK;
+        bOK = false;
+    }
+    timer.source = source;
+    timer.nsPerTick = TIMER_TSC == source ? timerCalibrateTsc() : 1.0;
+    timer.overheadTicks = 0;
+    std::vector<uint64_t> ticks;
+    timerEmptyIntervals(TIMER_OVERHEAD_SAMPLES, ticks);
+    // The smallest, so that a real interval is never made too short.
+    timer.overheadTicks = *std::min_element(ticks.begin(), ticks.end());
+    return bOK;
+}
+
+void timerMeasure(int nSamples, TypTimerQuality &quality)
+{
+    std::vector<uint64_t> ticks;
+    timerEmptyIntervals(nSamples, ticks);
+    std::sort(ticks.begin(), ticks.end());
+    quality.overheadNs = ticks[0] * timer.nsPerTick;
+
+    // The smallest step between successive reads.
+    uint64_t step = UINT64_MAX;
+    uint64_t prev = timerStop();
+    for(int j=0; j<nSamples; j++) {
+        uint64_t now = timerStop();
+        if(now > prev && now - prev < step) step = now - prev;
+        prev = now;
+    }
+    quality.resolutionNs = UINT64_MAX == step ? 0 : step * timer.nsPerTick;
+
+    double sum = 0, sumSquares = 0;
+    for(uint64_t interval : ticks) {
+        double ns = (double) timerTicksToNs(interval);
+        sum += ns;
+        sumSquares += ns * ns;
+    }
+    double mean = sum / nSamples;
+    quality.medianNs = (double) timerTicksToNs(ticks[nSamples/2]);
+    quality.jitterNs = sqrt(std::max(0.0, sumSquares / nSamples - mean * mean));
+}
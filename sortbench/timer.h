@@ -0,0 +1,103 @@
+//
+//  timer.h
+//  sortbench
+//
+//  Timing of sorts.  Two sources are available:
+//  - clock: the monotonic system clock, in nanoseconds.  This is
+//    clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW) on macOS and
+//    clock_gettime(CLOCK_MONOTONIC_RAW) elsewhere.
+//  - tsc: the x86 time-stamp counter, read with rdtsc at the start and
+//    rdtscp at the stop, fenced so that the sort can't be reordered
+//    around them.  Only used if the CPU says the counter is invariant,
+//    that is, runs at a constant rate in every power state.  Its rate is
+//    calibrated against the clock when the timer is initialized.
+//  Either way, the cost of reading the timer itself, measured at
+//  initialization, is subtracted from each interval, so that sorts of a
+//  few thousand elements are not dominated by it.
+//
+
+#ifndef timer_h
+#define timer_h
+
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAVE_TSC 1
+#else
+#define TIMER_HAVE_TSC 0
+#endif
+
+typedef uint64_t sb_timer_t;
+
+enum TypTimerSource {TIMER_CLOCK, TIMER_TSC, TIMER_MAX};
+
+struct TypTimer {
+    TypTimerSource source = TIMER_CLOCK;
+    double  nsPerTick = 1.0;
+    // Ticks between reading the start and the stop with nothing between.
+    uint64_t overheadTicks = 0;
+};
+extern TypTimer timer;
+
+// How good the timer is, from many empty intervals, in nanoseconds.
+struct TypTimerQuality {
+    double  overheadNs = 0;     // Smallest empty interval, before subtraction.
+    double  resolutionNs = 0;   // Smallest step the timer is seen to take.
+    double  medianNs = 0;       // Median empty interval, after subtraction.
+    double  jitterNs = 0;       // Standard deviation of the empty intervals.
+};
+
+const char *nameOfTimerSource(TypTimerSource source);
+// Whether the CPU has a time-stamp counter that runs at a constant rate.
+bool timerHaveInvariantTsc();
+// Use source, calibrating it and measuring its overhead.  If the TSC is
+// asked for but not invariant, the clock is used.  Returns false then.
+bool timerInit(TypTimerSource source);
+// Measure the quality of the current timer with nSamples empty intervals.
+void timerMeasure(int nSamples, TypTimerQuality &quality);
+
+// The system clock in nanoseconds, for timing that needs no precision.
+sb_timer_t getCurrentNanoseconds();
+
+// Ticks of the current source, in the order start ... stop.
+inline uint64_t timerStart()
+{
+#if TIMER_HAVE_TSC
+    if(TIMER_TSC == timer.source) {
+        _mm_lfence();
+        uint64_t ticks = __rdtsc();
+        _mm_lfence();
+        return ticks;
+    }
+#endif
+    return getCurrentNanoseconds();
+}
+
+inline uint64_t timerStop()
+{
+#if TIMER_HAVE_TSC
+    if(TIMER_TSC == timer.source) {
+        unsigned int aux;
+        uint64_t ticks = __rdtscp(&aux);
+        _mm_lfence();
+        return ticks;
+    }
+#endif
+    return getCurrentNanoseconds();
+}
+
+// Nanoseconds in an interval of ticks, less the overhead of the timer.
+inline sb_timer_t timerTicksToNs(uint64_t ticks)
+{
+    ticks = ticks > timer.overheadTicks ? ticks - timer.overheadTicks : 0;
+    return (sb_timer_t) (ticks * timer.nsPerTick + 0.5);
+}
+
+// Usage:  uint64_t start = timerStart();  ...  elapsedNs = timerElapsedNs(start);
+inline sb_timer_t timerElapsedNs(uint64_t start)
+{
+    uint64_t stop = timerStop();
+    return timerTicksToNs(stop - start);
+}
+
+#endif /* timer_h */